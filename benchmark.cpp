@@ -0,0 +1,242 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#include "davis_putnam.h"
+
+/* Benchmark runner: solves every problem file (*.dp) of a corpus with both solving methods,
+   reports time, search nodes and peak memory. With --record the results are stored as a
+   baseline, with --check they are compared to one and regressions fail the run.
+
+   benchmark [--corpus DIR] [--repeat N] [--record FILE | --check FILE] [--threshold PCT] */
+
+static const std::string BASELINE_HEADER = "dptrees-baseline 1";
+
+// Measurements of one problem solved with one method.
+struct Result {
+	std::string instance, engine;
+	double time_ms = 0; // Best of repeated solves.
+	uint nodes = 0;
+	long rss_kb = 0; // Peak resident memory of process solving it.
+	int verdict = -1;
+};
+
+/* Reads problem in dp input format: premises ending in ';', '0' ends input. The -treenodes and
+   -treedepth tags set the tree budget of both methods, so large searches fit in memory; other
+   tags are ignored. */
+static bool readProblem(const std::string& path, std::vector<std::string>& premises, SolveOptions& options) {
+	InputReader in(path);
+	std::string_view token;
+	while(in.next(token) && token != "0") {
+		if(token == "-treenodes" || token == "-treedepth") {
+			std::string_view value;
+			if(!in.next(value)) { return false; }
+			(token == "-treenodes" ? options.tree_nodes : options.tree_depth) = atoi(std::string(value).c_str());
+			continue;
+		}
+		if(token[0] == '-' || (char_class[(unsigned char)token[0]] & CH_DIGIT)) { continue; } // Tags.
+		if(token.back() != ';') { return false; }
+		premises.push_back(std::string(token.substr(0, token.size()-1)));
+	}
+	return true;
+}
+
+// Solves problem repeat times, keeps best time.
+static void measure(const std::vector<std::string>& premises, SolveOptions options, bool cnf, uint repeat,
+					Result& result) {
+	options.cnf = cnf;
+	for(uint i=0; i < repeat; ++i) {
+		Solver solver;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for(uint j=0; j < premises.size(); ++j) { solver.addPremise(premises[j]); }
+		result.verdict = solver.solve(options);
+		solver.getTree();
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-start).count();
+		if(!i || ms < result.time_ms) { result.time_ms = ms; }
+		result.nodes = solver.getNodes();
+	}
+}
+
+// Runs measurement in a child process so that its peak memory is its own.
+static Result run(const std::string& instance, const std::vector<std::string>& premises,
+				  const SolveOptions& options, bool cnf, uint repeat) {
+	Result result;
+	result.instance = instance;
+	result.engine = cnf ? "cnf" : "dp";
+#ifdef _WIN32
+	measure(premises, options, cnf, repeat, result); // No peak memory without separate process.
+#else
+	int fd[2];
+	if(pipe(fd)) { throw DPError("Cannot create pipe."); }
+	pid_t pid = fork();
+	if(pid < 0) { throw DPError("Cannot fork."); }
+	if(!pid) {
+		close(fd[0]);
+		try { measure(premises, options, cnf, repeat, result); }
+		catch(const DPError& e) { _exit(2); }
+		std::ostringstream out;
+		out << result.time_ms << " " << result.nodes << " " << result.verdict;
+		std::string text = out.str();
+		if(write(fd[1], text.c_str(), text.size()) < 0) { _exit(3); }
+		_exit(0);
+	}
+	close(fd[1]);
+	std::string text;
+	char buf[256];
+	ssize_t n;
+	while((n = read(fd[0], buf, sizeof(buf))) > 0) { text.append(buf, n); }
+	close(fd[0]);
+	int status;
+	struct rusage usage;
+	wait4(pid, &status, 0, &usage);
+	if(!WIFEXITED(status) || WEXITSTATUS(status)) { throw DPError("Solving " + instance + " failed."); }
+	std::istringstream in(text);
+	in >> result.time_ms >> result.nodes >> result.verdict;
+	result.rss_kb = usage.ru_maxrss;
+#endif
+	return result;
+}
+
+// Writes results as baseline file.
+static void record(const std::string& path, const std::vector<Result>& results) {
+	std::ofstream out(path);
+	if(!out) { throw DPError("Cannot write baseline " + path); }
+	out << BASELINE_HEADER << "\n# instance engine time_ms nodes rss_kb verdict\n";
+	for(uint i=0; i < results.size(); ++i) {
+		const Result& r = results[i];
+		out << r.instance << " " << r.engine << " " << r.time_ms << " " << r.nodes << " "
+			<< r.rss_kb << " " << r.verdict << "\n";
+	}
+}
+
+// Reads baseline file, keyed by instance and engine.
+static std::map<std::pair<std::string, std::string>, Result> load(const std::string& path) {
+	std::ifstream in(path);
+	if(!in) { throw DPError("Cannot read baseline " + path); }
+	std::string line;
+	if(!std::getline(in, line) || line != BASELINE_HEADER) {
+		throw DPError("Baseline " + path + " is not in format '" + BASELINE_HEADER + "'");
+	}
+	std::map<std::pair<std::string, std::string>, Result> baseline;
+	while(std::getline(in, line)) {
+		if(line.empty() || line[0] == '#') { continue; }
+		std::istringstream fields(line);
+		Result r;
+		if(!(fields >> r.instance >> r.engine >> r.time_ms >> r.nodes >> r.rss_kb >> r.verdict)) {
+			throw DPError("Malformed baseline line: " + line);
+		}
+		baseline[{r.instance, r.engine}] = r;
+	}
+	return baseline;
+}
+
+/* Prints one metric of the diff, returns true if it regressed: grew by more than threshold
+   percent and by more than the noise floor. */
+static bool compare(const std::string& name, double old_val, double new_val, double threshold,
+					double floor) {
+	double change = old_val ? 100.0*(new_val-old_val)/old_val : (new_val ? 100.0 : 0.0);
+	bool regress = new_val > old_val*(1.0+threshold/100.0) && new_val-old_val > floor;
+	char line[128];
+	snprintf(line, sizeof(line), "    %-8s %12.2f -> %12.2f  %+7.1f%%", name.c_str(), old_val, new_val, change);
+	std::cout << line << (regress ? "  REGRESSION" : "") << std::endl;
+	return regress;
+}
+
+// Compares results to baseline, returns number of regressions.
+static uint check(const std::string& path, const std::vector<Result>& results, double threshold) {
+	std::map<std::pair<std::string, std::string>, Result> baseline = load(path);
+	uint regressions = 0;
+	for(uint i=0; i < results.size(); ++i) {
+		const Result& r = results[i];
+		std::cout << r.instance << " [" << r.engine << "]" << std::endl;
+		std::map<std::pair<std::string, std::string>, Result>::const_iterator b_itr;
+		b_itr = baseline.find({r.instance, r.engine});
+		if(b_itr == baseline.end()) {
+			std::cout << "    not in baseline" << std::endl;
+			continue;
+		}
+		const Result& b = b_itr->second;
+		if(b.verdict != r.verdict) {
+			std::cout << "    verdict  " << b.verdict << " -> " << r.verdict << "  REGRESSION" << std::endl;
+			++regressions;
+		}
+		// Time below 1ms and memory below 1MB of growth is treated as noise.
+		regressions += compare("time_ms", b.time_ms, r.time_ms, threshold, 1.0);
+		regressions += compare("nodes", b.nodes, r.nodes, threshold, 0.0);
+		regressions += compare("rss_kb", b.rss_kb, r.rss_kb, threshold, 1024.0);
+	}
+	return regressions;
+}
+
+int main(int argc, char* argv[]) {
+	std::string corpus = "bench", record_path, check_path;
+	uint repeat = 3;
+	double threshold = 10.0; // Percent.
+	for(int i=1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if(i+1 >= argc) {
+			std::cerr << "Error: Missing value after " << arg << std::endl;
+			return 1;
+		}
+		if(arg == "--corpus") { corpus = argv[++i]; }
+		else if(arg == "--repeat") { repeat = std::max(1, atoi(argv[++i])); }
+		else if(arg == "--record") { record_path = argv[++i]; }
+		else if(arg == "--check") { check_path = argv[++i]; }
+		else if(arg == "--threshold") { threshold = atof(argv[++i]); }
+		else {
+			std::cerr << "Error: Unknown option " << arg << std::endl;
+			return 1;
+		}
+	}
+	try {
+		// Instances in name order so baselines line up between runs.
+		std::vector<std::string> files;
+		for(const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(corpus)) {
+			if(entry.path().extension() == ".dp") { files.push_back(entry.path().filename().string()); }
+		}
+		std::sort(files.begin(), files.end());
+		std::vector<Result> results;
+		for(uint i=0; i < files.size(); ++i) {
+			std::vector<std::string> premises;
+			SolveOptions options;
+			if(!readProblem(corpus + "/" + files[i], premises, options)) { throw DPError("Cannot read " + files[i]); }
+			for(int cnf=0; cnf < 2; ++cnf) {
+				results.push_back(run(files[i], premises, options, cnf, repeat));
+				const Result& r = results.back();
+				char line[160];
+				snprintf(line, sizeof(line), "%-28s %-4s %10.2f ms %10u nodes %8ld KB  verdict %d",
+						 r.instance.c_str(), r.engine.c_str(), r.time_ms, r.nodes, r.rss_kb, r.verdict);
+				std::cout << line << std::endl;
+			}
+		}
+		if(!record_path.empty()) {
+			record(record_path, results);
+			std::cout << "Baseline written to " << record_path << std::endl;
+		}
+		if(!check_path.empty()) {
+			std::cout << std::endl << "Compared to " << check_path << " (threshold " << threshold << "%)" << std::endl;
+			uint regressions = check(check_path, results, threshold);
+			if(regressions) {
+				std::cout << regressions << " regression(s)" << std::endl;
+				return 1;
+			}
+			std::cout << "No regressions" << std::endl;
+		}
+	} catch(const std::exception& e) {
+		std::cerr << "Error: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
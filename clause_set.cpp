@@ -3,45 +3,61 @@
 #include <vector>
 #include <list>
 #include <map>
+#include <set>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SSE41_DISPATCH // SSE4.1 scans compiled for any x86 target, used if the CPU has it.
+#include <smmintrin.h>
+#endif
 #include "davis_putnam.h"
 
-// Constructor from input statements, includes CNF conversion.
-ClauseSet::ClauseSet(std::list<FullStatement>& premises) {
-	std::list<FullStatement>::iterator s_itr;
-	for(s_itr = premises.begin(); s_itr != premises.end(); ++s_itr) {
-		s_itr->convertCNF();
-		Statement* s_ptr = s_itr->getRoot();
-		Clause cla;
-		// Iterate through leaf nodes, insert literals into clauses.
-		while(s_ptr->left_) { s_ptr = s_ptr->left_; }
-		cla[{s_ptr->s_atomics.begin()->first, !s_ptr->negated}] = s_ptr->s_atomics.begin()->second;
-		Statement* end = s_itr->getRoot(); // Rightmost leaf node.
-		while(end->right_) { end = end->right_; }
-		while(s_ptr != end) {
-			while(s_ptr->parent_ && s_ptr->parent_->right_ == s_ptr) { s_ptr = s_ptr->parent_; }
-			s_ptr = s_ptr->parent_->right_;
-			if(s_ptr->parent_->op_sym == '&') { // Make new clauses after encountering conjunctions.
-				clauses.push_back(cla);
-				cla.clear();
-			}
-			while(s_ptr->left_) { s_ptr = s_ptr->left_; }
-			cla[{s_ptr->s_atomics.begin()->first, !s_ptr->negated}] = s_ptr->s_atomics.begin()->second;
-		}
-		clauses.push_back(cla);
-		if(s_itr != premises.begin()) { // For each new premise, add new literals to single map.
-			premises.begin()->getRoot()->mergeAtomics(s_itr->getRoot()->s_atomics);
+// Converts premise into CNF, then appends its clauses. Returns false if limits are reached first.
+bool ClauseSet::extract(FullStatement& premise, std::list<Clause>& cls, bool write, SearchLimits* limits) {
+	TraceScope trace("convertCNF");
+	size_t first = cls.size();
+	if(!premise.convertCNF(write, limits)) { return false; }
+	Statement* s_ptr = premise.getRoot();
+	Clause cla;
+	// Iterate through leaf nodes, insert literals into clauses.
+	while(s_ptr->left_) { s_ptr = s_ptr->left_; }
+	cla[{s_ptr->atom_->getName(), !s_ptr->negated}] = s_ptr->atom_;
+	Statement* end = premise.getRoot(); // Rightmost leaf node.
+	while(end->right_) { end = end->right_; }
+	while(s_ptr != end) {
+		while(s_ptr->parent_ && s_ptr->parent_->right_ == s_ptr) { s_ptr = s_ptr->parent_; }
+		s_ptr = s_ptr->parent_->right_;
+		if(s_ptr->parent_->op_sym == '&') { // Make new clauses after encountering conjunctions.
+			cls.push_back(cla);
+			cla.clear();
 		}
+		while(s_ptr->left_) { s_ptr = s_ptr->left_; }
+		cla[{s_ptr->atom_->getName(), !s_ptr->negated}] = s_ptr->atom_;
 	}
-	atomics_ = &(premises.begin()->getRoot()->s_atomics);
+	cls.push_back(cla);
+	trace.size = cls.size()-first; // Clauses made.
+	return true;
 }
 
 // Main solving function for clauses.
 bool ClauseSet::evaluate(const Literal& prev, uint index) {
+	if(state.limitReached()) { return false; }
+	TraceScope trace("node", state.depth);
+	uint trail_size = state.trail.size(), equiv_size = state.equiv.size();
+	if(index) { state.trail.push_back(prev); }
 	// Adds current state to output encoding.
 	write((prev.second ? "" : "!") + prev.first, index);
+	if(trace.active()) {
+		if(index) { trace.lit = (prev.second ? "" : "!") + prev.first; }
+		trace.size = clauses.size();
+	}
 	std::pair<bool,bool> result = emptyClause();
 	// Terminate with either open or closed branch if needed.
-	if(result.first) { return result.second; }
+	if(result.first) {
+		// Without pure literal elimination, literals not on trail are free.
+		if(result.second) { state.openBranch(state.all ? atomics.size()-state.trail.size() : 0); }
+		state.trail.resize(trail_size);
+		state.equiv.resize(equiv_size);
+		return result.second;
+	}
 	// Proceed with smallest sized clause, unit preference resolution if possible.
 	iterator min_itr = getSmallest();
 	Literal lit = min_itr->begin()->first;
@@ -57,59 +73,138 @@ bool ClauseSet::evaluate(const Literal& prev, uint index) {
 	bool true_branch, false_branch;
 	// If current clause is unit literal, only make one branch.
 	if(!unit_neg.first || unit_neg.second) {
-		bool erase;
-		for(iterator itr = clauses.begin(); itr != clauses.end(); erase ? itr : ++itr) {
-			erase = false;
-			Clause::iterator c_itr = itr->find(lit);
-			if(c_itr != itr->end()) { // Delete entire clause if literal found.
-				itr = clauses.erase(itr);
-				erase = true;
-			} else {
-				// Only remove negated literal from clause if found.
-				c_itr = itr->find(neg_lit);
-				if(c_itr != itr->end()) { itr->erase(c_itr); }
-			}
-		}
-		true_branch = evaluate(lit, 2*index+1);
+		assign(lit);
+		true_branch = branch(lit, 2*index+1);
 	}
 	else { true_branch = false; }
 	// Same as above, but setting current literal to false.
-	if(!unit_neg.first || !unit_neg.second) {
-		bool erase;
-		for(iterator itr = clauses.begin(); itr != clauses.end(); erase ? itr : ++itr) {
-			erase = false;
-			Clause::iterator c_itr = itr->find(neg_lit);
-			if(c_itr != itr->end()) {
-				itr = clauses.erase(itr);
-				erase = true;
-			} else {
-				c_itr = itr->find(lit);
-				if(c_itr != itr->end()) { itr->erase(c_itr); }
-			}
-		}
-		false_branch = evaluate(neg_lit, 2*index+2);
+	if((!unit_neg.first || !unit_neg.second) && !state.stop) {
+		clauses = clauses_saved;
+		measured = false;
+		assign(neg_lit);
+		false_branch = branch(neg_lit, 2*index+2);
 	}
 	else { false_branch = false; }
 	clauses = clauses_saved;
+	measured = false;
+	state.trail.resize(trail_size);
+	state.equiv.resize(equiv_size);
 	return true_branch || false_branch;
 }
 
-// Returns clause with least number of literals.
-ClauseSet::iterator ClauseSet::getSmallest() {
-	iterator min_itr;
-	uint size = atomics_->size()+1;
+// Recurses into branch one level down, written as summary node if past level of detail budget.
+bool ClauseSet::branch(const Literal& lit, uint index) {
+	bool collapsed = state.beginNode();
+	uint parent = state.parent;
+	++state.depth;
+	bool open = evaluate(lit, index);
+	--state.depth;
+	state.parent = parent;
+	if(collapsed) { state.endCollapse(open, (lit.second ? "" : "!") + lit.first, output_tree, index); }
+	return open;
+}
+
+/* Sets literal to true: deletes clauses containing it, removes its negation from the rest.
+   Sizes of remaining clauses are measured on the way. */
+void ClauseSet::assign(const Literal& lit) {
+	Literal neg_lit = negate(lit);
+	sizes.clear();
+	positions.clear();
+	bool erase;
+	for(iterator itr = clauses.begin(); itr != clauses.end(); erase ? itr : ++itr) {
+		erase = false;
+		Clause::iterator c_itr = itr->find(lit);
+		if(c_itr != itr->end()) { // Delete entire clause if literal found.
+			itr = clauses.erase(itr);
+			erase = true;
+		} else {
+			// Only remove negated literal from clause if found.
+			c_itr = itr->find(neg_lit);
+			if(c_itr != itr->end()) { itr->erase(c_itr); }
+			sizes.push_back(itr->size());
+			positions.push_back(itr);
+		}
+	}
+	measured = true;
+}
+
+// Fills size and position of each clause after clauses were changed other than by assign().
+void ClauseSet::measure() {
+	sizes.clear();
+	positions.clear();
 	for(iterator itr = clauses.begin(); itr != clauses.end(); ++itr) {
-		if(itr->size() < size) {
-			min_itr = itr;
-			size = itr->size();
+		sizes.push_back(itr->size());
+		positions.push_back(itr);
+	}
+	measured = true;
+}
+
+#ifdef SSE41_DISPATCH
+// Whether the CPU has SSE4.1, checked once at start.
+static bool hasSse41() {
+	__builtin_cpu_init(); // Static initializers may run before the CPU model is read.
+	return __builtin_cpu_supports("sse4.1");
+}
+static const bool sse41 = hasSse41();
+
+// Least of sizes up to a multiple of four, i set past them.
+__attribute__((target("sse4.1"))) static uint minSize4(const uint* sizes, uint n, uint& i) {
+	__m128i m = _mm_set1_epi32(-1);
+	for(; i+4 <= n; i += 4) { m = _mm_min_epu32(m, _mm_loadu_si128((const __m128i*)(sizes+i))); }
+	m = _mm_min_epu32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(1,0,3,2)));
+	m = _mm_min_epu32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2,3,0,1)));
+	return _mm_cvtsi128_si32(m);
+}
+
+// Index of first size equal to value up to a multiple of four, n if none and i set past them.
+__attribute__((target("sse4.1"))) static uint findSize4(const uint* sizes, uint n, uint value, uint& i) {
+	__m128i v = _mm_set1_epi32(value);
+	for(; i+4 <= n; i += 4) {
+		int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(sizes+i)), v)));
+		if(!mask) { continue; }
+		while(!(mask & 1)) {
+			mask >>= 1;
+			++i;
 		}
+		return i;
 	}
-	return min_itr;
+	return n;
+}
+#endif
+
+// Least of n sizes, four at a time with SSE4.1 when the CPU has it.
+static uint minSize(const uint* sizes, uint n) {
+	uint i = 0, least = ~0u;
+#ifdef SSE41_DISPATCH
+	if(sse41) { least = minSize4(sizes, n, i); }
+#endif
+	for(; i < n; ++i) { least = std::min(least, sizes[i]); }
+	return least;
+}
+
+// Index of first of n sizes equal to value, n if none.
+static uint findSize(const uint* sizes, uint n, uint value) {
+	uint i = 0;
+#ifdef SSE41_DISPATCH
+	if(sse41 && findSize4(sizes, n, value, i) < n) { return i; }
+#endif
+	for(; i < n; ++i) {
+		if(sizes[i] == value) { return i; }
+	}
+	return n;
+}
+
+// Returns first clause with least number of literals.
+ClauseSet::iterator ClauseSet::getSmallest() {
+	if(!measured) { measure(); }
+	if(sizes.empty()) { return clauses.end(); }
+	return positions[findSize(&sizes[0], sizes.size(), minSize(&sizes[0], sizes.size()))];
 }
 
 // Returns if terminating condition is met and whether branch is open or closed.
 std::pair<bool,bool> ClauseSet::emptyClause() const {
 	if(clauses.empty()) { return {true,true}; }
+	if(measured) { return {findSize(&sizes[0], sizes.size(), 0) < sizes.size(), false}; }
 	for(const_iterator itr = clauses.begin(); itr != clauses.end(); ++itr) {
 		if(itr->empty()) { return {true,false}; }
 	}
@@ -118,6 +213,7 @@ std::pair<bool,bool> ClauseSet::emptyClause() const {
 
 // Tautology Elimination: deletes clauses containing both a literal and its negation.
 bool ClauseSet::elimTaut() {
+	TraceScope trace("TautElim", state.depth);
 	bool elim = false;
 	bool erase;
 	for(iterator itr = clauses.begin(); itr != clauses.end(); erase ? itr : ++itr) {
@@ -132,17 +228,20 @@ bool ClauseSet::elimTaut() {
 			}
 		}
 	}
+	trace.size = clauses.size();
+	if(elim) { measured = false; }
 	return elim;
 }
 
 // Subsumption Elimination: deletes clauses subsumed by other clauses.
 bool ClauseSet::elimSub() {
+	TraceScope trace("SubElim", state.depth);
 	bool elim = false;
 	// Copy clauses and sort by size.
 	std::list<Clause> copy(clauses);
 	copy.sort(sortClause);
-	// Remove smallest and compare to each clause.
-	while(copy.size() > 1) {
+	// Remove smallest and compare to each clause, clauses found so far are deleted if interrupted.
+	while(copy.size() > 1 && !state.interrupted()) {
 		Clause smallest = copy.front();
 		copy.pop_front();
 		bool erase;
@@ -166,54 +265,381 @@ bool ClauseSet::elimSub() {
 			}
 		}
 	}
+	trace.size = clauses.size();
+	if(elim) { measured = false; }
 	return elim;
 }
 
 // Pure Literal Elimination: remove clause if it contains literal never or always negated.
 bool ClauseSet::elimPure() {
+	TraceScope trace("PureElim", state.depth);
 	bool elim = false;
-	std::vector<std::string> del_atomics;
-	std::vector<Clause*> del_pure;
+	// Count non-negated and negated literals of each atomic in one pass.
+	std::map<std::string, std::pair<uint, uint> > counts;
+	for(const_iterator itr = clauses.begin(); itr != clauses.end(); ++itr) {
+		for(Clause::const_iterator c_itr = itr->begin(); c_itr != itr->end(); ++c_itr) {
+			std::pair<uint, uint>& count = counts[c_itr->first.first];
+			++(c_itr->first.second ? count.first : count.second);
+		}
+	}
+	std::set<std::string> pure;
 	std::map<std::string, Atomic*>::iterator a_itr;
-	// Iterate through atomics, search for negated and non-negated literals.
-	for(a_itr = atomics_->begin(); a_itr != atomics_->end(); ++a_itr) {
-		std::vector<Clause*> pure;
-		bool true_lit = false;
-		bool false_lit = false;
-		for(iterator itr = clauses.begin(); itr != clauses.end(); ++itr) {
-			if(itr->find({a_itr->first, true}) != itr->end()) {
-				true_lit = true;
-				pure.push_back(&(*itr));
-			} else if(itr->find({a_itr->first, false}) != itr->end()) {
-				false_lit = true;
-				pure.push_back(&(*itr));
+	for(a_itr = atomics.begin(); a_itr != atomics.end();) {
+		std::map<std::string, std::pair<uint, uint> >::const_iterator n_itr = counts.find(a_itr->first);
+		// Remove atomic if not found in any clauses (not updated elsewhere).
+		if(n_itr == counts.end()) {
+			a_itr = atomics.erase(a_itr);
+			continue;
+		}
+		if(n_itr->second.first && n_itr->second.second) {
+			++a_itr;
+			continue;
+		}
+		pure.insert(a_itr->first);
+		state.trail.push_back({a_itr->first, n_itr->second.first}); // Pure literal can always be set.
+		a_itr = atomics.erase(a_itr);
+		elim = true;
+	}
+	bool erase;
+	for(iterator itr = clauses.begin(); elim && itr != clauses.end(); erase ? itr : ++itr) {
+		erase = false;
+		Clause::const_iterator c_itr = itr->begin();
+		while(c_itr != itr->end() && pure.find(c_itr->first.first) == pure.end()) { ++c_itr; }
+		if(c_itr != itr->end()) {
+			itr = clauses.erase(itr);
+			erase = true;
+		}
+	}
+	trace.size = clauses.size();
+	if(elim) { measured = false; }
+	return elim;
+}
+
+// Clauses indexed by literal code (2*atomic id+value) for probing, probe assignments are undone.
+struct ProbeIndex {
+	std::vector<std::string> names; // Atomic of each id.
+	std::vector<std::vector<uint> > lits, occurs; // Codes of each clause, clauses of each code.
+	std::vector<uint> free; // Literals of each clause not yet set false.
+	std::vector<bool> sat;
+	std::vector<int> val; // Value of each atomic, -1 if not set.
+	std::vector<uint> units; // Clauses left with one literal by fixed literals.
+	std::vector<uint> queue, set; // Codes to propagate, codes set by current probe.
+	std::vector<std::pair<uint, std::pair<uint, bool> > > undo; // Clause with previous free and sat.
+	uint n_sat = 0;
+	bool closed = false; // A clause has all literals false.
+	unsigned long long work = 0; // Clauses visited.
+
+	ProbeIndex(const std::list<Clause>& clauses, std::map<std::string, uint>& ids);
+	void assign(uint code, bool fixed);
+	bool propagate(bool fixed);
+	bool probe(int code);
+	void reset();
+	bool pending();
+};
+
+ProbeIndex::ProbeIndex(const std::list<Clause>& clauses, std::map<std::string, uint>& ids) {
+	for(std::list<Clause>::const_iterator itr = clauses.begin(); itr != clauses.end(); ++itr) {
+		lits.push_back(std::vector<uint>());
+		for(Clause::const_iterator c_itr = itr->begin(); c_itr != itr->end(); ++c_itr) {
+			std::pair<std::map<std::string, uint>::iterator, bool> id = ids.insert({c_itr->first.first, names.size()});
+			if(id.second) {
+				names.push_back(c_itr->first.first);
+				occurs.resize(2*names.size());
 			}
-			// Cut short if both negated and non-negated found.
-			if(true_lit && false_lit) { break; }
+			uint code = 2*id.first->second + c_itr->first.second;
+			lits.back().push_back(code);
+			occurs[code].push_back(lits.size()-1);
 		}
-		if((true_lit || false_lit) && !(true_lit && false_lit)) {
-			for(uint i=0; i < pure.size(); ++i) {
-				std::vector<Clause*>::iterator pure_itr;
-				pure_itr = std::find(del_pure.begin(), del_pure.end(), pure[i]);
-				if(pure_itr == del_pure.end()) { del_pure.push_back(pure[i]); }
-				elim = true;
+		free.push_back(itr->size());
+		if(itr->size() == 1) { units.push_back(lits.size()-1); }
+		if(itr->empty()) { closed = true; }
+	}
+	sat.assign(lits.size(), false);
+	val.assign(names.size(), -1);
+}
+
+// Sets literal, clauses containing it are satisfied at once. Fixed literals are kept by reset().
+void ProbeIndex::assign(uint code, bool fixed) {
+	val[code/2] = code & 1;
+	if(!fixed) { set.push_back(code); }
+	for(uint i=0; i < occurs[code].size(); ++i) {
+		uint c = occurs[code][i];
+		if(sat[c]) { continue; }
+		if(!fixed) { undo.push_back({c, {free[c], false}}); }
+		sat[c] = true;
+		if(fixed) { ++n_sat; }
+	}
+	queue.push_back(code);
+}
+
+/* Removes negations of queued literals from clauses. Unit clauses are propagated while
+   probing, and kept for next probe when fixing. Returns false if a clause has all literals false. */
+bool ProbeIndex::propagate(bool fixed) {
+	for(uint q=0; q < queue.size(); ++q) {
+		const std::vector<uint>& neg = occurs[queue[q]^1];
+		for(uint i=0; i < neg.size(); ++i) {
+			uint c = neg[i];
+			++work;
+			if(sat[c]) { continue; }
+			if(!fixed) { undo.push_back({c, {free[c], false}}); }
+			if(!--free[c]) {
+				queue.clear();
+				return false;
 			}
-			del_atomics.push_back(a_itr->first);
-		// Remove atomic if not found in any clauses (not updated elsewhere).
-		} else if(!true_lit && !false_lit) { del_atomics.push_back(a_itr->first); }
+			if(free[c] > 1) { continue; }
+			if(fixed) {
+				units.push_back(c);
+				continue;
+			}
+			for(uint j=0; j < lits[c].size(); ++j) { // Literals set false but still queued are not free.
+				if(val[lits[c][j]/2] < 0) {
+					assign(lits[c][j], false);
+					break;
+				}
+			}
+		}
 	}
-	for(uint i=0; i < del_atomics.size(); ++i) {
-		atomics_->erase(atomics_->find(del_atomics[i]));
+	queue.clear();
+	return true;
+}
+
+/* Sets literal (none if negative) and literals of unit clauses, then propagates them. Literals
+   set are left in set until reset(). */
+bool ProbeIndex::probe(int code) {
+	if(code >= 0 && val[code/2] < 0) { assign(code, false); }
+	for(uint i=0; i < units.size(); ++i) {
+		uint c = units[i];
+		if(sat[c]) { continue; }
+		for(uint j=0; j < lits[c].size(); ++j) {
+			if(val[lits[c][j]/2] < 0) {
+				assign(lits[c][j], false);
+				break;
+			}
+		}
 	}
-	for(uint i=0; i < del_pure.size(); ++i) {
-		iterator del_itr = std::find(clauses.begin(), clauses.end(), *del_pure[i]);
-		clauses.erase(del_itr);
+	return propagate(false);
+}
+
+// Undoes literals set by probe, fixed literals kept.
+void ProbeIndex::reset() {
+	for(uint i=0; i < set.size(); ++i) { val[set[i]/2] = -1; }
+	set.clear();
+	for(uint i=undo.size(); i-- > 0;) {
+		free[undo[i].first] = undo[i].second.first;
+		sat[undo[i].first] = undo[i].second.second;
 	}
-	return elim;
+	undo.clear();
+}
+
+// Whether unit clauses are left by fixed literals, satisfied ones dropped.
+bool ProbeIndex::pending() {
+	uint kept = 0;
+	for(uint i=0; i < units.size(); ++i) {
+		if(!sat[units[i]]) { units[kept++] = units[i]; }
+	}
+	units.resize(kept);
+	return kept;
+}
+
+/* Failed Literal Probing: sets each atomic both ways and propagates unit clauses. If one value
+   fails, the other is fixed with everything it implies; otherwise literals implied by both
+   values are fixed. Atomics only in clauses of three or more literals imply nothing and are
+   skipped. Propagation is budgeted per call, in clauses visited. */
+bool ClauseSet::elimProbe() {
+	TraceScope trace("Probe", state.depth);
+	std::map<std::string, uint> ids;
+	ProbeIndex index(clauses, ids);
+	unsigned long long budget = 4096;
+	for(uint c=0; c < index.lits.size(); ++c) { budget += 16*index.lits[c].size(); }
+	std::vector<Literal> fixed;
+	std::map<std::string, Atomic*>::const_iterator a_itr;
+	for(a_itr = atomics.begin(); a_itr != atomics.end() && !index.closed && index.n_sat < index.lits.size() &&
+		index.work < budget && !state.interrupted(); ++a_itr) {
+		std::map<std::string, uint>::const_iterator id = ids.find(a_itr->first);
+		int code = id == ids.end() || index.val[id->second] >= 0 ? -1 : 2*id->second;
+		bool probed = index.pending();
+		for(uint v=0; code >= 0 && v < 2 && !probed; ++v) {
+			const std::vector<uint>& occ = index.occurs[code+v];
+			for(uint i=0; i < occ.size() && !probed; ++i) { probed = !index.sat[occ[i]] && index.free[occ[i]] <= 2; }
+		}
+		if(!probed) { continue; }
+		bool pos_open = index.probe(code >= 0 ? code+1 : -1);
+		std::vector<uint> pos(index.set);
+		index.reset();
+		bool neg_open = index.probe(code);
+		if(!pos_open && !neg_open) { // Closed either way.
+			clauses.assign(1, Clause());
+			measured = false;
+			trace.size = 1;
+			return true;
+		}
+		// Literals of positive probe also set by negative probe (still set), or all of the open one.
+		std::vector<uint> both;
+		for(uint i=0; pos_open && i < pos.size(); ++i) {
+			if(!neg_open || index.val[pos[i]/2] == int(pos[i] & 1)) { both.push_back(pos[i]); }
+		}
+		if(!pos_open) { both = index.set; }
+		index.reset();
+		std::sort(both.begin(), both.end(), [&](uint a, uint b) { return index.names[a/2] < index.names[b/2]; });
+		for(uint i=0; i < both.size(); ++i) {
+			fixed.push_back({index.names[both[i]/2], bool(both[i] & 1)});
+			state.trail.push_back(fixed.back());
+			index.assign(both[i], true);
+		}
+		if(!both.empty() && !index.propagate(true)) { index.closed = true; }
+	}
+	if(fixed.empty()) {
+		trace.size = clauses.size();
+		return false;
+	}
+	// Same as assigning each fixed literal in turn.
+	std::map<std::string, bool> values(fixed.begin(), fixed.end());
+	bool erase;
+	for(iterator itr = clauses.begin(); itr != clauses.end(); erase ? itr : ++itr) {
+		erase = false;
+		for(Clause::iterator c_itr = itr->begin(); !erase && c_itr != itr->end();) {
+			std::map<std::string, bool>::const_iterator v_itr = values.find(c_itr->first.first);
+			if(v_itr == values.end()) { ++c_itr; }
+			else if(v_itr->second == c_itr->first.second) { // Delete entire clause if literal true.
+				itr = clauses.erase(itr);
+				erase = true;
+			} else { c_itr = itr->erase(c_itr); }
+		}
+	}
+	measured = false;
+	trace.size = clauses.size();
+	return true;
+}
+
+/* Tarjan's algorithm over implication graph of binary clauses, fills component of each literal.
+   Literals being visited are kept on an explicit stack with their next edge. */
+static void strongConnect(uint root, const std::vector<std::vector<uint> >& edges, std::vector<int>& low,
+						  std::vector<int>& order, std::vector<uint>& stack, std::vector<bool>& on_stack,
+						  std::vector<int>& comp, int& counter, int& n_comp) {
+	std::vector<std::pair<uint, uint> > visits(1, std::make_pair(root, 0u));
+	order[root] = low[root] = counter++;
+	stack.push_back(root);
+	on_stack[root] = true;
+	while(!visits.empty()) {
+		uint v = visits.back().first;
+		if(visits.back().second < edges[v].size()) {
+			uint w = edges[v][visits.back().second++];
+			if(order[w] < 0) {
+				order[w] = low[w] = counter++;
+				stack.push_back(w);
+				on_stack[w] = true;
+				visits.push_back(std::make_pair(w, 0u));
+			} else if(on_stack[w]) { low[v] = std::min(low[v], order[w]); }
+			continue;
+		}
+		visits.pop_back();
+		if(!visits.empty()) { low[visits.back().first] = std::min(low[visits.back().first], low[v]); }
+		if(low[v] != order[v]) { continue; }
+		uint w;
+		do {
+			w = stack.back();
+			stack.pop_back();
+			on_stack[w] = false;
+			comp[w] = n_comp;
+		} while(w != v);
+		++n_comp;
+	}
+}
+
+/* Equivalent Literal Substitution: literals on a cycle of binary clauses (A$B, B$A) are
+   equal, each is replaced by the least literal of its cycle. */
+bool ClauseSet::elimEquiv() {
+	TraceScope trace("EquivElim", state.depth);
+	if(state.interrupted()) { return false; }
+	// Binary clause {a,b} gives implications !a->b and !b->a.
+	std::map<Literal, uint> ids;
+	std::vector<Literal> lits;
+	std::vector<std::vector<uint> > edges;
+	for(const_iterator itr = clauses.begin(); itr != clauses.end(); ++itr) {
+		if(itr->size() != 2) { continue; }
+		uint end[2];
+		Clause::const_iterator c_itr = itr->begin();
+		for(uint i=0; i < 2; ++i, ++c_itr) {
+			for(uint j=0; j < 2; ++j) {
+				Literal lit = j ? negate(c_itr->first) : c_itr->first;
+				if(ids.insert({lit, lits.size()}).second) {
+					lits.push_back(lit);
+					edges.push_back(std::vector<uint>());
+				}
+			}
+			end[i] = ids[c_itr->first];
+		}
+		edges[ids[negate(lits[end[0]])]].push_back(end[1]);
+		edges[ids[negate(lits[end[1]])]].push_back(end[0]);
+	}
+	std::vector<int> low(lits.size()), order(lits.size(), -1), comp(lits.size());
+	std::vector<uint> stack;
+	std::vector<bool> on_stack(lits.size(), false);
+	int counter = 0, n_comp = 0;
+	for(uint v=0; v < lits.size(); ++v) {
+		if(order[v] < 0) { strongConnect(v, edges, low, order, stack, on_stack, comp, counter, n_comp); }
+	}
+	// Least literal of each component, ids follow literal order.
+	std::vector<int> rep(n_comp, -1);
+	std::map<Literal, uint>::const_iterator l_itr;
+	for(l_itr = ids.begin(); l_itr != ids.end(); ++l_itr) {
+		if(rep[comp[l_itr->second]] < 0) { rep[comp[l_itr->second]] = l_itr->second; }
+	}
+	std::map<std::string, Literal> subst; // Atomic to literal it equals.
+	for(l_itr = ids.begin(); l_itr != ids.end(); ++l_itr) {
+		if(comp[l_itr->second] == comp[ids[negate(l_itr->first)]]) { // Literal equals its negation.
+			clauses.assign(1, Clause());
+			measured = false;
+			trace.size = 1;
+			return true;
+		}
+		const Literal& r = lits[rep[comp[l_itr->second]]];
+		if(r.first == l_itr->first.first || subst.find(l_itr->first.first) != subst.end()) { continue; }
+		subst[l_itr->first.first] = l_itr->first.second ? r : negate(r);
+		state.equiv.push_back({{l_itr->first.first, true}, subst[l_itr->first.first]});
+	}
+	trace.size = clauses.size();
+	if(subst.empty()) { return false; }
+	bool erase;
+	for(iterator itr = clauses.begin(); itr != clauses.end(); erase ? itr : ++itr) {
+		erase = false;
+		Clause cla;
+		for(Clause::const_iterator c_itr = itr->begin(); c_itr != itr->end(); ++c_itr) {
+			std::map<std::string, Literal>::const_iterator s_itr = subst.find(c_itr->first.first);
+			if(s_itr == subst.end()) { cla.insert(*c_itr); }
+			else {
+				Literal lit = c_itr->first.second ? s_itr->second : negate(s_itr->second);
+				cla[lit] = atomics[lit.first];
+			}
+		}
+		// Substitution can leave both a literal and its negation.
+		Clause::const_iterator c_itr = cla.begin();
+		while(c_itr != cla.end() && cla.find(negate(c_itr->first)) == cla.end()) { ++c_itr; }
+		if(c_itr != cla.end()) {
+			itr = clauses.erase(itr);
+			erase = true;
+		} else { *itr = cla; }
+	}
+	trace.size = clauses.size();
+	measured = false;
+	return true;
 }
 
 // Main function for writing output solving tree graphic encoding.
 void ClauseSet::write(const std::string& curr_atom, uint index) {
+	if(!state.write) { // Verdict only, still apply elimination strategies.
+		if(!index) { elimTaut(); }
+		elimSub();
+		elimProbe();
+		// Pure literal elimination and substitution keep consistency but not the number of models.
+		if(!state.all) { elimEquiv(); }
+		while(!state.all && elimPure()) {}
+		return;
+	}
+	if(state.record) {
+		record(curr_atom, index);
+		return;
+	}
 	// Backfill with blank elements to maintain heap order.
 	while(index+1 > output_tree.size()) { output_tree.push_back("# "); }
 	output_tree[index] = "";
@@ -221,6 +647,7 @@ void ClauseSet::write(const std::string& curr_atom, uint index) {
 	output_tree[index] += " #";
 	if(clauses.empty()) {
 		output_tree[index] += " [True]"; // Terminate with open branch.
+		state.wrote(output_tree[index].size());
 		return;
 	}
 	for(iterator itr = clauses.begin(); itr != clauses.end(); ++itr) {
@@ -243,12 +670,68 @@ void ClauseSet::write(const std::string& curr_atom, uint index) {
 		writeElim(elim);
 		output_tree[index] += elim;
 	}
+	if(elimProbe()) {
+		elim = " >Probe";
+		writeElim(elim);
+		output_tree[index] += elim;
+	}
+	if(!state.all && elimEquiv()) {
+		elim = " >EquivElim";
+		writeElim(elim);
+		output_tree[index] += elim;
+	}
 	// More pure clauses can be generated after each successful attempt.
-	while(elimPure()) {
+	while(!state.all && elimPure()) {
 		elim = " >PureElim";
 		writeElim(elim);
 		output_tree[index] += elim;
 	}
+	state.wrote(output_tree[index].size());
+}
+
+// Structured version of write(), clauses referred to by formula id.
+void ClauseSet::record(const std::string& curr_atom, uint index) {
+	std::vector<uint> ids;
+	recordFormulas(ids);
+	state.parent = state.record->node(state.parent, index ? curr_atom : "", ids);
+	if(!clauses.empty()) {
+		if(!index && elimTaut()) {
+			recordFormulas(ids);
+			state.record->step(state.parent, "TautElim", ids);
+		}
+		if(elimSub()) {
+			recordFormulas(ids);
+			state.record->step(state.parent, "SubElim", ids);
+		}
+		if(elimProbe()) {
+			recordFormulas(ids);
+			state.record->step(state.parent, "Probe", ids);
+		}
+		if(!state.all && elimEquiv()) {
+			recordFormulas(ids);
+			state.record->step(state.parent, "EquivElim", ids);
+		}
+		while(!state.all && elimPure()) {
+			recordFormulas(ids);
+			state.record->step(state.parent, "PureElim", ids);
+		}
+	}
+	state.wroteRecord();
+}
+
+// Fills ids of current clauses in formula table.
+void ClauseSet::recordFormulas(std::vector<uint>& ids) const {
+	ids.clear();
+	std::string text;
+	for(const_iterator itr = clauses.begin(); itr != clauses.end(); ++itr) {
+		text = "{";
+		for(Clause::const_iterator c_itr = itr->begin(); c_itr != itr->end(); ++c_itr) {
+			if(c_itr != itr->begin()) { text += ","; }
+			text += (c_itr->first.second ? "" : "!") + c_itr->first.first;
+		}
+		text += "}";
+		ids.push_back(state.record->formula(text));
+	}
 }
 
 // Helper output function, adds elimination strategy steps.
@@ -1,23 +1,75 @@
 #ifndef davis_putnam_h_
 #define davis_putnam_h_
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <istream>
+#include <mutex>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <list>
 #include <map>
+#include <unordered_map>
 
 typedef unsigned int uint; //Hopefully this fixes the compilation errors
 
+// Thrown for invalid input or solver misuse instead of terminating the process.
+class DPError : public std::runtime_error {
+public:
+	DPError(const std::string& msg) : std::runtime_error(msg) {}
+};
+
+// Classes of input characters, flags looked up in char_class.
+enum CharClass { CH_LETTER = 1, CH_OPERATOR = 2, CH_NEGATE = 4, CH_OPEN = 8, CH_CLOSE = 16,
+				 CH_SPACE = 32, CH_DIGIT = 64 };
+extern const std::array<unsigned char, 256> char_class;
+
+/* Tokenizes input without copying it: regular files are memory-mapped, pipes and terminals
+   read in large blocks into one buffer. Tokens are views into that buffer, valid while the
+   reader exists. */
+class InputReader {
+public:
+	InputReader(); // Standard input, read as tokens are needed unless it is a file.
+	explicit InputReader(const std::string& path);
+	explicit InputReader(std::string_view text) : data(text.data()), size(text.size()) {}
+	~InputReader();
+
+	bool next(std::string_view& token);
+
+private:
+	InputReader(const InputReader&);
+	InputReader& operator=(const InputReader&);
+	void load(int fd, bool whole = true);
+	void readStream(std::istream& in);
+	bool more(size_t& start);
+
+	// Representation
+	std::string buffer; // Input read in blocks, unused if mapped.
+	std::list<std::string> blocks; // Input read so far when streamed, kept for tokens into them.
+	int stream = -1; // Descriptor read as tokens are needed, -1 once at its end.
+	bool handed = false; // Token returned from last block, which then cannot grow.
+	void* mapped_ = NULL; // Start of mapped file.
+	const char* data = NULL;
+	size_t size = 0, pos = 0;
+};
+
 // Objects for setting and keeping track of truth values for atomic statements.
 class Atomic {
 public:
 	Atomic();
-	Atomic(const std::string& n) : name(n) {}
+	Atomic(const std::string& n, uint i) : name(n), id(i) {}
 
 	// Accessors
 	bool getValue() const;
+	bool isSet() const { return set_val; }
 	int getQuantity() const { return quantity; }
 	const std::string& getName() const { return name; }
+	uint getId() const { return id; }
 
 	// Modifiers
 	void setValue(bool v);
@@ -28,34 +80,58 @@ public:
 private:
 	// Representation
 	std::string name;
+	uint id; // Index among atomics of solver, used in AtomSet.
 	int quantity = 0; // Number of occurances in all input statements.
 	bool val, set_val=false; // Truth value and whether truth value has been set.
 };
 
+/* Set of atomics by id, one bit each. Ids below 64 are kept inline, so small statements
+   need no allocation; union is a word-wise or and copying copies words. */
+class AtomSet {
+public:
+	bool contains(uint id) const {
+		if(id < 64) { return low >> id & 1; }
+		return id/64-1 < high.size() && high[id/64-1] >> id%64 & 1;
+	}
+	void insert(uint id);
+	void erase(uint id);
+	void merge(const AtomSet& s2);
+
+private:
+	// Representation
+	uint64_t low = 0; // Ids 0 to 63.
+	std::vector<uint64_t> high; // Words for ids from 64 on.
+};
+
+typedef std::pair<std::string, bool> Literal;
+typedef std::map<Literal, Atomic*> Clause;
 
+class Statement;
 class FullStatement;
 class ClauseSet;
+class SearchLimits;
+typedef std::map<uint, std::vector<Statement*> > LeafIndex; // Leaf nodes of each atomic by id.
 
 // Node objects for storing binary and negation operators as well as relevant literals.
 class Statement {
 public:
 	friend class FullStatement;
 	friend class ClauseSet;
+	friend struct NormalFrame;
 
 private:
 	Statement() {}
 	Statement(const std::string& raw_stat, std::map<std::string,Atomic*>& atomics, std::string& orig);
-	bool containsAtomic(const std::string& a) const;
+	bool containsAtomic(uint id) const { return s_atomics.contains(id); }
 
-	// Construction/destruction helper functions.
-	Statement* copy() const;
-	void destroy();
+	// Construction/destruction helper functions, leaf index kept up to date if given.
+	Statement* copy(LeafIndex* leaves = NULL) const;
+	void destroy(LeafIndex* leaves = NULL);
 
 	// Helper functions for solving.
-	void mergeAtomics(const std::map<std::string, Atomic*>& atoms2);
-	Statement* evaluate();
+	Statement* evaluate(LeafIndex* leaves);
 	void reassign(Statement& s2);
-	void simplify(Statement* keep);
+	void simplify(Statement* keep, LeafIndex* leaves);
 
 	// Helper functions for CNF conversion.
 	void elimConditional();
@@ -63,14 +139,20 @@ private:
 	void DeMorgan();
 	void DistribDisjunct(bool nested_left);
 
+	// Helper functions for simplifying before solving.
+	Statement* normalize(int& value, std::string& key);
+	Statement* replaceBy(Statement* keep, bool flip);
+	void resetAtomics();
+
 	// Representation
 	char op_sym = ' '; // Binary operator symbol, space is used for atomic statements.
 	bool negated = false; // Presence of negation operator
-	bool val, set_val = false; // Truth value and whether truth value has been set.
+	bool val = false, set_val = false; // Truth value and whether truth value has been set.
 	Statement* parent_ = NULL;
 	Statement* left_ = NULL;
 	Statement* right_ = NULL;
-	std::map<std::string, Atomic*> s_atomics; // All literals beneath operator.
+	Atomic* atom_ = NULL; // Literal of leaf node.
+	AtomSet s_atomics; // All literals beneath operator.
 };
 
 /* Top-level object for holding contained Statement objects. Uses tree structure to
@@ -84,29 +166,182 @@ public:
 	// Accessors
 	const std::string& getOrig() const { return orig; }
 	Statement* getRoot() const { return root_; }
-	bool containsAtomic(const std::string& a) const;
+	std::vector<Atomic*> getAtomics() const;
+	bool containsAtomic(const Atomic* a) const { return root_->containsAtomic(a->getId()); }
 	bool getValSet() const { return set_val; }
 	bool getVal() const { return val; }
+	bool isLiteral(Literal& lit) const;
+	void countAtomics() const;
 	
-	// Main solving functions
-	void evaluate(const std::string& curr_a);
+	// Main solving functions, text statement only rewritten if write is set.
+	void evaluate(const Atomic* curr_a, bool write = true);
 	void rewrite();
 	
-	void convertCNF();
+	bool convertCNF(bool write = true, SearchLimits* limits = NULL);
+	std::string normalize();
 
 private:
 	std::string rewrite(Statement* s) const;
-	void convertCNF(Statement* s);
+	bool convertCNF(Statement* s, SearchLimits* limits);
+	bool distribute(Statement* s, SearchLimits* limits);
+	void index();
 
 	// Representation
 	Statement* root_ = NULL;
 	bool val, set_val = false; // Truth value and whether truth value has been set.
 	std::string orig; // Written logical expression.
-	std::map<std::string, Atomic*>* atomics_; // All literals used in full statment.
+	std::vector<Atomic*> statement_atomics; // All literals used in full statement, by id.
+	LeafIndex leaves; // Evaluation starts at leaves of atomic instead of searching from root.
 };
 
-typedef std::pair<std::string, bool> Literal;
-typedef std::map<Literal, Atomic*> Clause;
+// Encodings of output tree.
+enum TreeFormat { TREE_TEXT, TREE_JSONL };
+
+// Options for a single solve.
+struct SolveOptions {
+	bool cnf = false; // Solve with clauses instead of original statements.
+	bool verdict_only = false; // Skip rewriting statements and building the output tree.
+	// Search budgets, 0 for no limit. Reaching one gives an unknown verdict.
+	uint max_nodes = 0; // Search nodes expanded.
+	uint time_limit_ms = 0; // Wall time from start of solve.
+	uint max_output = 0; // Bytes of output tree text.
+	// Level of detail for output tree, 0 for no limit. Subtrees past either budget are written
+	// as one summary node while search continues without text.
+	uint tree_nodes = 0; // Nodes written in full.
+	uint tree_depth = 0; // Depth of nodes written in full, 16 if only tree_nodes is set.
+	TreeFormat tree_format = TREE_TEXT;
+};
+
+// Structured output tree: each formula text stored once, nodes refer to formulas by id.
+class TreeRecord {
+public:
+	static const uint NO_PARENT = ~0u;
+
+	void clear();
+	uint formula(const std::string& text);
+	uint node(uint parent, const std::string& lit, const std::vector<uint>& formulas);
+	void step(uint node, const std::string& rule, const std::vector<uint>& formulas);
+	uint summary(uint parent, const std::string& lit, bool open, uint n, uint depth);
+
+	// Accessors
+	uint getBytes() const { return bytes; } // Approximate size of encoding.
+	std::string str() const;
+
+private:
+	struct Node {
+		uint parent;
+		std::string lit; // Literal on branch from parent.
+		std::vector<uint> formulas;
+		std::vector<std::pair<std::string, std::vector<uint> > > steps; // Simplifications at node.
+		bool summary = false, open = false; // Summary of collapsed subtree and its result.
+		uint summary_nodes = 0, summary_depth = 0;
+	};
+
+	// Representation
+	std::unordered_map<std::string, uint> table; // Formula text to id.
+	std::vector<const std::string*> texts; // Formula text by id, keys of table.
+	std::vector<Node> nodes;
+	uint bytes = 0;
+};
+
+/* Timeline of solving events in Chrome trace format, loadable by chrome://tracing and
+   Perfetto. Each thread records into its own buffer; buffers are merged when written.
+   While tracing is off an event costs one relaxed load. */
+class Trace {
+public:
+	static void start();
+	static bool enabled() { return on.load(std::memory_order_relaxed); }
+	static void write(const std::string& path); // Stops tracing and clears events.
+
+	static void begin(const char* name, uint depth);
+	static void end(const char* name, const std::string& lit, size_t size);
+
+private:
+	static std::atomic<bool> on;
+};
+
+/* Begin event when made and end event when left, if tracing. Literal and size (statements
+   or clauses left) are filled in before leaving and shown with the end event. */
+class TraceScope {
+public:
+	TraceScope(const char* name, uint depth = 0) : name_(Trace::enabled() ? name : NULL) {
+		if(name_) { Trace::begin(name_, depth); }
+	}
+	~TraceScope() { if(name_) { Trace::end(name_, lit, size); } }
+	bool active() const { return name_; }
+
+	std::string lit;
+	size_t size = 0;
+
+private:
+	TraceScope(const TraceScope&);
+	TraceScope& operator=(const TraceScope&);
+	const char* name_;
+};
+
+// Budgets shared by every search of one solve, checked at each search node.
+class SearchLimits {
+public:
+	SearchLimits(const SolveOptions& options, std::atomic<bool>* cancel);
+	~SearchLimits() { if(cancel_) { *cancel_ = false; } } // Cancel request ends with its solve.
+
+	bool exceeded();
+	bool interrupted();
+	void addOutput(uint bytes) { output += bytes; }
+	bool reached() const { return reached_; }
+
+private:
+	// Representation
+	std::atomic<bool>* cancel_; // Set by another thread to stop the solve.
+	uint max_nodes, max_output;
+	bool timed;
+	std::chrono::steady_clock::time_point deadline;
+	uint nodes = 0, output = 0; // Used so far.
+	std::atomic<bool> reached_{false}; // Also set by threads converting premises.
+};
+
+// State shared by every node of a single search, used by both solving methods.
+struct SearchState {
+	void openBranch(uint free_atoms);
+	// Cheap check at each node, stops all recursive steps once a budget is used up.
+	bool limitReached() {
+		if(limits && limits->exceeded()) { stop = true; }
+		return stop;
+	}
+	// Check within long steps at a node, for time limit and cancelling only.
+	bool interrupted() {
+		if(limits && limits->interrupted()) { stop = true; }
+		return stop;
+	}
+	void wrote(uint bytes) { if(limits) { limits->addOutput(bytes); } }
+	void wroteRecord() {
+		wrote(record->getBytes()-recorded);
+		recorded = record->getBytes();
+	}
+	bool beginNode();
+	void endCollapse(bool open, const std::string& lit, std::vector<std::string>& output_tree, uint index);
+
+	SearchLimits* limits = NULL; // No budgets if NULL.
+	TreeRecord* record = NULL; // Structured output tree written instead of text if set.
+	uint parent = TreeRecord::NO_PARENT; // Record id of node whose branches are being made.
+	uint recorded = 0; // Bytes of record already counted as output.
+
+	bool write = true; // Build text for output tree encoding.
+	bool all = false; // Explore every branch instead of stopping at first open branch.
+	bool keep_cubes = false; // Keep literals of every open branch when exploring all.
+	uint max_cubes = 0; // Stop after this many open branches when keeping them, 0 for no limit.
+	bool solved = false; // Open branch found.
+	bool stop = false; // Allows immediate return of all recursive steps.
+	std::vector<Literal> trail; // Literals set on current branch.
+	std::vector<std::pair<Literal, Literal> > equiv; // Literals substituted on current branch, with their equals.
+	std::vector<std::vector<Literal> > cubes; // Trails of open branches.
+	unsigned long long count = 0; // Number of assignments satisfying all statements/clauses.
+	uint tree_nodes = 0, tree_depth = 0; // Level of detail budgets, see SolveOptions.
+	uint written = 0; // Nodes written in full.
+	uint depth = 0; // Depth of node whose branches are being made.
+	uint nodes = 0; // Nodes made, including those without text.
+	uint collapse_nodes = 0, max_depth = 0; // Start count and deepest node of collapsed subtree.
+};
 
 // Alternate method for storing and solving logical arguments using CNF and clause conversion.
 class ClauseSet {
@@ -114,12 +349,19 @@ public:
 	typedef std::list<Clause>::iterator iterator;
 	typedef std::list<Clause>::const_iterator const_iterator;
 
-	ClauseSet(std::list<FullStatement>& premises);
+	ClauseSet(const std::list<Clause>& cls, const std::map<std::string, Atomic*>& atoms)
+		: clauses(cls), atomics(atoms) {}
 	bool evaluate(const Literal& lit, uint index);
+	bool branch(const Literal& lit, uint index);
+	void assign(const Literal& lit);
+	static bool extract(FullStatement& premise, std::list<Clause>& cls, bool write = true,
+						SearchLimits* limits = NULL);
 
 	// Accessors
 	iterator getSmallest();
+	const std::list<Clause>& getClauses() const { return clauses; }
 	const std::vector<std::string>& getOutput() const { return output_tree; }
+	SearchState& getState() { return state; }
 	std::pair<bool,bool> emptyClause() const;
 
 private:
@@ -127,17 +369,147 @@ private:
 	bool elimTaut();
 	bool elimSub();
 	bool elimPure();
+	bool elimProbe();
+	bool elimEquiv();
+	void measure();
 
 	// Output writing functions
 	void write(const std::string& curr_atom, uint index);
 	void writeElim(std::string& elim) const;
+	void record(const std::string& curr_atom, uint index);
+	void recordFormulas(std::vector<uint>& ids) const;
 
 	// Representation
 	std::list<Clause> clauses;
-	std::map<std::string, Atomic*>* atomics_; // All literals used in clauses.
+	// Size and position of each clause in list order, scanned instead of list if measured.
+	std::vector<uint> sizes;
+	std::vector<iterator> positions;
+	bool measured = false;
+	std::map<std::string, Atomic*> atomics; // All literals used in clauses.
 	std::vector<std::string> output_tree; // Text for tree graphic encoding.
+	SearchState state; // Trail also includes pure literals, which keeps models valid.
+};
+
+// Result of solving a premise set, unknown if a search budget ran out first.
+enum Verdict { INCONSISTENT = 0, CONSISTENT = 1, UNKNOWN = 2 };
+
+/* Embeddable, incremental solving interface. Premises are parsed (and converted to clauses)
+   once, then solved repeatedly under assumption literals or with extra premises pushed and
+   popped. Errors are thrown as DPError. Each instance owns all of its state, so separate
+   instances can be used concurrently from different threads. */
+class Solver {
+public:
+	Solver() {}
+	~Solver();
+
+	// Premise management
+	void addPremise(std::string_view raw_stat); // Whitespace is ignored.
+	void addPremises(const std::vector<std::string_view>& raw_stats);
+	void setJobs(uint n) { jobs = std::max(1u, n); } // Threads parsing and converting premises.
+	void push() { frames.push_back(premises.size()); }
+	void pop();
+
+	// Solving
+	Verdict solve(const SolveOptions& options = SolveOptions(),
+				  const std::vector<Literal>& assumptions = std::vector<Literal>());
+
+	// Model enumeration and counting
+	uint enumerate(const SolveOptions& options = SolveOptions(),
+				   const std::vector<Literal>& assumptions = std::vector<Literal>(), uint max_models = 0);
+	unsigned long long count(const SolveOptions& options = SolveOptions(),
+							 const std::vector<Literal>& assumptions = std::vector<Literal>());
+
+	/* Stops solve running on another thread, which then returns an unknown verdict. If none is
+	   running, the next solve, enumerate or count stops instead. */
+	void cancel() { cancelled = true; }
+
+	// Accessors for results of last solve
+	bool limitReached() const { return limit_reached; } // Results are partial if set.
+	uint getNodes() const { return search_nodes; }
+	const std::map<std::string, bool>& getModel() const { return model; }
+	const std::vector<std::map<std::string, bool> >& getModels() const { return models; }
+	const std::vector<std::string>& getOutput() const { return output_tree; }
+	std::string getTree() const { return jsonl_tree ? record.str() : formatTree(output_tree); }
+	uint numPremises() const { return premises.size(); }
+	// Earlier premise that premise i repeats, i itself if solved, -1 if always true.
+	int premiseSource(uint i) const { return sources.at(i); }
+	// Keys of premise set for ResultCache.
+	std::string premiseText() const;
+	std::string canonicalText(std::vector<std::string>& names) const;
+
+	static void checkStatement(std::string& stat);
+	static std::string formatTree(const std::vector<std::string>& output_tree);
+
+private:
+	Solver(const Solver&);
+	Solver& operator=(const Solver&);
+
+	// Helper functions for loading current premises under assumptions.
+	bool loadStatements(const std::vector<Literal>& assumptions, bool write,
+						std::list<FullStatement>& full_statements);
+	bool loadClauses(const std::vector<Literal>& assumptions, std::list<Clause>& cls,
+					 std::map<std::string, Atomic*>& atoms, SearchLimits& limits);
+	void universe(const std::vector<Literal>& assumptions, std::map<std::string, bool>& free) const;
+
+	// Representation
+	std::list<FullStatement> premises; // Parsed and simplified premises, never modified by solving.
+	std::vector<int> sources; // See premiseSource(), only premises that are their own source are solved.
+	std::unordered_map<std::string, uint> canonical; // Canonical text of each solved premise.
+	std::vector<std::vector<std::string> > premise_atoms; // Atomics of each premise as entered.
+	std::list<std::list<Clause> > premise_clauses; // Clauses of each premise, converted once.
+	std::vector<FullStatement*> cut_short; // Copies left by conversions at a limit, freed later.
+	std::vector<uint> frames; // Number of premises at each push().
+	std::map<std::string, Atomic*> atomics; // All literals ever parsed, owned by solver.
+	std::vector<std::string> output_tree; // Text for tree graphic encoding of last solve.
+	TreeRecord record; // Structured tree of last solve.
+	bool jsonl_tree = false; // Last solve wrote record instead of text.
+	std::map<std::string, bool> model; // Satisfying assignment found by last solve.
+	std::vector<std::map<std::string, bool> > models; // Assignments listed by last enumerate().
+	std::atomic<bool> cancelled{false}; // Set by cancel(), cleared when a solve ends.
+	bool limit_reached = false; // Last solve stopped at a search budget.
+	uint search_nodes = 0; // Search tree nodes made by last solve.
+	uint jobs = 1; // See setJobs().
+};
+
+/* Results of earlier solves kept in a directory, which several processes may share. Verdict
+   and model are keyed by hash of the premise set as solved (see Solver::canonicalText), so
+   premise sets differing in premise order or atomic names are found. Trees are keyed by the
+   premises as entered and the options that shape the tree. Entries are written to a
+   temporary file and renamed into place, oldest used entries are removed past max_bytes.
+   Size of the directory is read once and then kept up to date by stores; entries written by
+   other processes are counted when the directory is next read for eviction. */
+class ResultCache {
+public:
+	ResultCache(const std::string& dir, uintmax_t max_bytes);
+
+	// Fills result of solving current premises of solver, tree only if given. False if not cached.
+	bool load(const Solver& solver, const SolveOptions& options, Verdict& verdict,
+			  std::map<std::string, bool>& model, std::string* tree = NULL) const;
+	// Stores result of last solve of solver, which had no assumptions. Unknown verdicts are not stored.
+	void store(const Solver& solver, const SolveOptions& options, Verdict verdict) const;
+
+	static uint64_t hash(const std::string& text);
+
+private:
+	std::string entryPath(char kind, const std::string& key) const;
+	bool read(const std::string& path, const std::string& key, std::string& value) const;
+	void write(const std::string& path, const std::string& key, const std::string& value) const;
+	uintmax_t evict() const;
+
+	// Representation
+	std::string dir;
+	uintmax_t max_bytes;
+	mutable std::mutex total_mutex; // Guards total and eviction.
+	mutable uintmax_t total = 0; // Bytes in directory.
 };
 
+void recount(std::map<std::string,Atomic*>& atomics, const std::list<FullStatement>& full_statements);
+void write_output(const std::list<FullStatement>& full_statements, const std::string& curr_atom,
+				  std::vector<std::string>& output_tree, uint index);
+void write_summary(const std::string& summary, const std::string& curr_atom,
+				   std::vector<std::string>& output_tree, uint index);
+bool dpSolve(const std::list<FullStatement>& full_statements, std::map<std::string,Atomic*>& atomics,
+			 std::vector<std::string>& output_tree, uint index, SearchState& state);
 void redundancy(std::string& stat);
 Literal negate(const Literal& lit);
 bool sortClause(const Clause& c1, const Clause& c2);
@@ -1,55 +1,86 @@
 #include <string>
+#include <vector>
 #include <map>
+#include <unordered_map>
 #include "davis_putnam.h"
 
 // Constructor from input text.
 FullStatement::FullStatement(const std::string& raw_stat, std::map<std::string,Atomic*>& atomics) {
 	root_ = new Statement(raw_stat, atomics, orig);
-	atomics_ = &(root_->s_atomics);
+	index();
 }
 
 // Copy constructor.
 FullStatement::FullStatement(const FullStatement& fs) {
-	//root_ = copy(fs.root_);
-	root_ = fs.root_->copy();
+	root_ = fs.root_->copy(&leaves);
 	orig = fs.orig;
-	atomics_ = &(root_->s_atomics);
+	statement_atomics = fs.statement_atomics;
 }
 
-// Returns true if atomic in Statement tree.
-bool FullStatement::containsAtomic(const std::string& a) const {
-	if(atomics_->find(a) != atomics_->end()) { return true; }
-	return false;
+// Returns atomics still in Statement tree, in order of id.
+std::vector<Atomic*> FullStatement::getAtomics() const {
+	std::vector<Atomic*> atoms;
+	for(uint i=0; i < statement_atomics.size(); ++i) {
+		if(root_->containsAtomic(statement_atomics[i]->getId())) { atoms.push_back(statement_atomics[i]); }
+	}
+	return atoms;
 }
 
-// Main solving function: iterates through Statement objects, sets value and simplifies.
-void FullStatement::evaluate(const std::string& curr_a) {
-	Statement* s_ptr = root_;
-	while(true) {
-		// Find leaf node or lowest node containing current atomic.
-		while(s_ptr->op_sym != ' ') {
-			if(!s_ptr->left_->set_val && s_ptr->left_->containsAtomic(curr_a)) {
-				s_ptr = s_ptr->left_;
-			} else if(!s_ptr->right_->set_val && s_ptr->right_->containsAtomic(curr_a)) {
-				s_ptr = s_ptr->right_;
-			} else { break; }
+/* Main solving function: sets value of leaves of current atomic, then evaluates and simplifies
+   their ancestors upward, each once all of its children holding the atomic are done. */
+void FullStatement::evaluate(const Atomic* curr_a, bool write) {
+	LeafIndex::iterator l_itr = leaves.find(curr_a->getId());
+	if(set_val || l_itr == leaves.end()) { return; }
+	std::vector<Statement*> ready;
+	ready.swap(l_itr->second);
+	leaves.erase(l_itr);
+	// Count children holding atomic of each affected node.
+	std::unordered_map<Statement*, uint> pending;
+	for(uint i=0; i < ready.size(); ++i) {
+		for(Statement* s_ptr = ready[i]; s_ptr->parent_; s_ptr = s_ptr->parent_) {
+			if(++pending[s_ptr->parent_] > 1) { break; } // Ancestors above already counted.
 		}
+	}
+	while(!ready.empty()) {
+		Statement* s_ptr = ready.back();
+		ready.pop_back();
 		if(s_ptr->op_sym == ' ') { // Set value of leaf node.
-			s_ptr->val = s_ptr->s_atomics[curr_a]->getValue();
+			s_ptr->val = curr_a->getValue();
 			s_ptr->set_val = true;
 			if(s_ptr->negated) { s_ptr->val = !s_ptr->val; }
 		} else {
-			s_ptr = s_ptr->evaluate();
-			s_ptr->s_atomics.erase(curr_a);
-		} // Reaching the root means no further evalution can be completed.
-		if(!s_ptr->parent_) { break; }
-		s_ptr = s_ptr->parent_; // Iterate upward.
+			s_ptr = s_ptr->evaluate(&leaves);
+			s_ptr->s_atomics.erase(curr_a->getId());
+		}
+		if(s_ptr->parent_ && !--pending[s_ptr->parent_]) { ready.push_back(s_ptr->parent_); }
 	}
 	if(root_->set_val) { // Value of root, if set, is value of FullStatement.
-		val = s_ptr->val;
+		val = root_->val;
 		set_val = true;
 	}
-	rewrite();
+	if(write) { rewrite(); }
+}
+
+// Returns true if statement not yet evaluated is a single literal, which is filled in.
+bool FullStatement::isLiteral(Literal& lit) const {
+	if(set_val || root_->op_sym != ' ') { return false; }
+	lit = {root_->atom_->getName(), !root_->negated};
+	return true;
+}
+
+// Adds occurrences of each atomic in Statement tree to its quantity.
+void FullStatement::countAtomics() const {
+	if(set_val) { return; }
+	std::vector<const Statement*> stack(1, root_);
+	while(!stack.empty()) {
+		const Statement* s = stack.back();
+		stack.pop_back();
+		if(s->op_sym == ' ') { ++(*s->atom_); }
+		else {
+			stack.push_back(s->right_);
+			stack.push_back(s->left_);
+		}
+	}
 }
 
 // Use Statement tree to rewrite text statement after revisions/simplifications.
@@ -65,45 +96,132 @@ void FullStatement::rewrite() {
 	redundancy(orig);
 }
 
-// Convert original input statements into Conjunctive Normal Form.
-void FullStatement::convertCNF() {
-	convertCNF(root_);
-	rewrite();
+/* Convert original input statements into Conjunctive Normal Form. Returns false if limits are
+   reached first, statement is then left partly converted. */
+bool FullStatement::convertCNF(bool write, SearchLimits* limits) {
+	if(!convertCNF(root_, limits)) { return false; }
+	index(); // Conversion copies and moves leaves.
+	if(write) { rewrite(); }
+	return true;
+}
+
+/* Simplifies statement tree before solving, text is kept as entered. Value is set if the
+   statement is always true or false. Returns canonical text, same for premises that differ
+   only in operand order. */
+std::string FullStatement::normalize() {
+	TraceScope trace("normalize");
+	int value;
+	std::string key;
+	root_ = root_->normalize(value, key);
+	root_->parent_ = NULL;
+	root_->resetAtomics();
+	index();
+	LeafIndex::const_iterator l_itr;
+	for(l_itr = leaves.begin(); trace.active() && l_itr != leaves.end(); ++l_itr) {
+		trace.size += l_itr->second.size(); // Leaves left.
+	}
+	if(value >= 0) {
+		val = value;
+		set_val = true;
+		key = value ? "[True]" : "[False]";
+	}
+	return key;
+}
+
+// Rebuilds leaf index and list of atomics after tree is restructured.
+void FullStatement::index() {
+	leaves.clear();
+	statement_atomics.clear();
+	std::vector<Statement*> stack(1, root_);
+	while(!stack.empty()) {
+		Statement* s = stack.back();
+		stack.pop_back();
+		if(s->op_sym == ' ') { leaves[s->atom_->getId()].push_back(s); }
+		else {
+			stack.push_back(s->right_);
+			stack.push_back(s->left_);
+		}
+	}
+	LeafIndex::const_iterator l_itr;
+	for(l_itr = leaves.begin(); l_itr != leaves.end(); ++l_itr) {
+		statement_atomics.push_back(l_itr->second[0]->atom_);
+	}
 }
 
-// Recursive helper function of rewrite().
+// Helper function of rewrite(), writes text of nodes from explicit stack in order.
 std::string FullStatement::rewrite(Statement* s) const {
 	std::string syntax;
-	if(s->negated) { syntax += '!'; }
-	if(s->op_sym == ' ') {
-		syntax += s->s_atomics.begin()->first;
-		return syntax;
+	// Node to write, or closing text to write if node is NULL.
+	std::vector<std::pair<const Statement*, char> > stack(1, std::make_pair(s, ' '));
+	while(!stack.empty()) {
+		const Statement* curr_s = stack.back().first;
+		char c = stack.back().second;
+		stack.pop_back();
+		if(!curr_s) {
+			syntax += c;
+			continue;
+		}
+		if(curr_s->negated) { syntax += '!'; }
+		if(curr_s->op_sym == ' ') {
+			syntax += curr_s->atom_->getName();
+			continue;
+		}
+		syntax += '(';
+		stack.push_back(std::make_pair((const Statement*)NULL, ')'));
+		stack.push_back(std::make_pair(curr_s->right_, ' '));
+		stack.push_back(std::make_pair((const Statement*)NULL, curr_s->op_sym));
+		stack.push_back(std::make_pair(curr_s->left_, ' '));
 	}
-	syntax += '(' + rewrite(s->left_) + s->op_sym + rewrite(s->right_) + ')';
 	return syntax;
 }
 
-// Recursive helper function fo convertCNF().
-void FullStatement::convertCNF(Statement* s) {
-	if(s->op_sym == ' ') { return; }
-	if(s->op_sym == '$') { s->elimConditional(); }
-	else if(s->op_sym == '%') {
-		/* Biconditionals split into conjuncted conditionals, need new parent node,
-		   special case if biconditional is root. */
-		bool root = false;
-		if(s == root_) { root = true; }
-		s = s->elimBiconditional();
-		if(root) { root_ = s; }
+/* Helper function of convertCNF(). Operators are rewritten on way down, children are converted
+   before their parent is distributed, using explicit stack. Limits checked every 256 nodes. */
+bool FullStatement::convertCNF(Statement* s, SearchLimits* limits) {
+	std::vector<std::pair<Statement*, bool> > stack(1, std::make_pair(s, false));
+	for(uint steps=1; !stack.empty(); ++steps) {
+		if(limits && !(steps & 255) && limits->interrupted()) { return false; }
+		Statement* curr_s = stack.back().first;
+		bool children_done = stack.back().second;
+		stack.pop_back();
+		if(curr_s->op_sym == ' ') { continue; }
+		if(children_done) {
+			if(!distribute(curr_s, limits)) { return false; }
+			continue;
+		}
+		if(curr_s->op_sym == '$') { curr_s->elimConditional(); }
+		else if(curr_s->op_sym == '%') {
+			/* Biconditionals split into conjuncted conditionals, need new parent node,
+			   special case if biconditional is root. */
+			bool root = false;
+			if(curr_s == root_) { root = true; }
+			curr_s = curr_s->elimBiconditional();
+			if(root) { root_ = curr_s; }
+		}
+		if(curr_s->negated) { curr_s->DeMorgan(); }
+		stack.push_back(std::make_pair(curr_s, true));
+		stack.push_back(std::make_pair(curr_s->right_, false));
+		stack.push_back(std::make_pair(curr_s->left_, false));
+	}
+	return true;
+}
+
+/* Helper function of convertCNF(), children already in CNF. For DNF expression, one or both
+   children may be conjunctions, distributing can leave new disjunctions of conjunctions below,
+   so repeat on both sides. Each distribution copies only the operand spread over the
+   conjunction. Returns false if limits are reached first. */
+bool FullStatement::distribute(Statement* s, SearchLimits* limits) {
+	std::vector<Statement*> stack(1, s);
+	for(uint steps=1; !stack.empty(); ++steps) {
+		if(limits && !(steps & 255) && limits->interrupted()) { return false; }
+		Statement* curr_s = stack.back();
+		stack.pop_back();
+		if(curr_s->op_sym != '|') { continue; }
+		if(curr_s->left_->op_sym == '&') { curr_s->DistribDisjunct(true); }
+		else if(curr_s->right_->op_sym == '&') { curr_s->DistribDisjunct(false); }
+		else { continue; }
+		stack.push_back(curr_s->right_);
+		stack.push_back(curr_s->left_);
 	}
-	if(s->negated) { s->DeMorgan(); }
-	convertCNF(s->left_);
-	convertCNF(s->right_);
-	// For DNF expression, one or both children may be conjunctions -> 3 cases.
-	if(s->op_sym == '|' && s->left_->op_sym == '&') {
-		if(s->right_->op_sym == '&') {
-			s->DistribDisjunct(true);
-			s->left_->DistribDisjunct(false);
-			s->right_->DistribDisjunct(false);
-		} else { s->DistribDisjunct(true); }
-	} else if(s->op_sym == '|' && s->right_->op_sym == '&') { s->DistribDisjunct(false); }
+	return true;
 }
\ No newline at end of file
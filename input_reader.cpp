@@ -0,0 +1,167 @@
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include "davis_putnam.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const size_t BLOCK_SIZE = 1 << 20; // Bytes read at once from pipes.
+
+// Builds character class table at compile time.
+static constexpr std::array<unsigned char, 256> classTable() {
+	std::array<unsigned char, 256> table = {};
+	for(int c='A'; c <= 'Z'; ++c) { table[c] = CH_LETTER; }
+	for(int c='a'; c <= 'z'; ++c) { table[c] = CH_LETTER; }
+	for(int c='0'; c <= '9'; ++c) { table[c] = CH_DIGIT; }
+	table['&'] = table['|'] = table['$'] = table['%'] = CH_OPERATOR;
+	table['!'] = table['~'] = CH_NEGATE; // Either negation shortcut.
+	table['('] = CH_OPEN;
+	table[')'] = CH_CLOSE;
+	table[' '] = table['\t'] = table['\n'] = table['\r'] = table['\v'] = table['\f'] = CH_SPACE;
+	return table;
+}
+
+const std::array<unsigned char, 256> char_class = classTable();
+
+/* Reader of standard input. Pipes and terminals are read as tokens are needed, so a problem
+   is answered once its '0' tag arrives, while input is still open. */
+InputReader::InputReader() {
+#ifdef _WIN32
+	readStream(std::cin);
+#else
+	load(0, false);
+#endif
+}
+
+// Reader of file, throws DPError if it cannot be read.
+InputReader::InputReader(const std::string& path) {
+#ifdef _WIN32
+	std::ifstream in(path, std::ios::binary);
+	if(!in) { throw DPError("Cannot read " + path); }
+	readStream(in);
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0) { throw DPError("Cannot read " + path); }
+	try { load(fd); }
+	catch(...) {
+		close(fd);
+		throw;
+	}
+	close(fd);
+#endif
+}
+
+InputReader::~InputReader() {
+#ifndef _WIN32
+	if(mapped_) { munmap(mapped_, size); }
+#endif
+}
+
+/* Maps regular files, reads anything else in blocks, all at once if whole or else as tokens
+   are needed. Starts at current offset of descriptor. */
+void InputReader::load(int fd, bool whole) {
+#ifndef _WIN32
+	struct stat st;
+	if(!fstat(fd, &st) && S_ISREG(st.st_mode) && st.st_size > 0) {
+		void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(map != MAP_FAILED) {
+			madvise(map, st.st_size, MADV_SEQUENTIAL);
+			mapped_ = map;
+			data = static_cast<const char*>(map);
+			size = st.st_size;
+			off_t offset = lseek(fd, 0, SEEK_CUR);
+			if(offset > 0 && size_t(offset) <= size) { pos = offset; }
+			return;
+		}
+	}
+	if(!whole) {
+		stream = fd;
+		return;
+	}
+	size_t used = 0;
+	ssize_t n;
+	do {
+		buffer.resize(used + BLOCK_SIZE);
+		n = read(fd, &buffer[used], BLOCK_SIZE);
+		if(n > 0) { used += n; }
+	} while(n > 0 || (n < 0 && errno == EINTR));
+	if(n < 0) { throw DPError(std::string("Cannot read input: ") + strerror(errno)); }
+	buffer.resize(used);
+	data = buffer.data();
+	size = used;
+#endif
+}
+
+// Reads whole stream in blocks, used where files cannot be mapped.
+void InputReader::readStream(std::istream& in) {
+	size_t used = 0;
+	while(in) {
+		buffer.resize(used + BLOCK_SIZE);
+		in.read(&buffer[used], BLOCK_SIZE);
+		used += in.gcount();
+	}
+	buffer.resize(used);
+	data = buffer.data();
+	size = used;
+}
+
+/* Reads more of streamed input, with text from start (a token not yet complete) moved to the
+   start of data. Last block grows in place unless a token was returned from it, otherwise the
+   text is copied to a new block. Returns false at end of input, token then runs to end. */
+bool InputReader::more(size_t& start) {
+#ifndef _WIN32
+	if(stream < 0) { return false; }
+	if(handed || blocks.empty()) {
+		blocks.push_back(size > start ? std::string(data+start, size-start) : std::string());
+		handed = false;
+	} else { blocks.back().erase(0, start); } // Only whitespace before start.
+	std::string& block = blocks.back();
+	size_t used = block.size();
+	block.resize(used + BLOCK_SIZE);
+	ssize_t n;
+	do { n = read(stream, &block[used], BLOCK_SIZE); } while(n < 0 && errno == EINTR);
+	if(n < 0) { throw DPError(std::string("Cannot read input: ") + strerror(errno)); }
+	block.resize(used + n);
+	data = block.data();
+	size = block.size();
+	start = 0;
+	pos = n ? 0 : size;
+	if(!n) { stream = -1; }
+	return n;
+#else
+	return false;
+#endif
+}
+
+/* Sets token to next tag or number (up to whitespace) or premise (up to and including ';',
+   whitespace inside kept). A premise missing ';' runs to end of input. Returns false at end
+   of input. Streamed input is only read further while token is not complete. */
+bool InputReader::next(std::string_view& token) {
+	size_t start;
+	while(true) {
+		while(pos < size && (char_class[(unsigned char)data[pos]] & CH_SPACE)) { ++pos; }
+		start = pos;
+		bool complete;
+		if(pos < size && (data[pos] == '-' || (char_class[(unsigned char)data[pos]] & CH_DIGIT))) {
+			while(pos < size && !(char_class[(unsigned char)data[pos]] & CH_SPACE)) { ++pos; }
+			complete = pos < size;
+		} else {
+			const void* end = pos < size ? memchr(data+pos, ';', size-pos) : NULL;
+			pos = end ? static_cast<const char*>(end)-data+1 : size;
+			complete = end != NULL;
+		}
+		if(complete || !more(start)) { break; }
+		pos = start;
+	}
+	if(start == size) { return false; }
+	token = std::string_view(data+start, pos-start);
+	handed = true;
+	return true;
+}
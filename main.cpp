@@ -1,259 +1,253 @@
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
-#include <list>
-#include <map>
 #include "davis_putnam.h"
 
-// Updates quantities of atomic statements after each solving step.
-void recount(std::map<std::string,Atomic*>& atomics, const std::list<FullStatement>& full_statements) {
-	std::map<std::string,Atomic*>::iterator a_itr;
-	std::list<FullStatement>::const_iterator s_itr;
-	// Loops through all atomics with inner loop through all statements.
-	for(a_itr = atomics.begin(); a_itr != atomics.end(); ++a_itr) {
-		a_itr->second->resetQuantity();
-		for(s_itr = full_statements.begin(); s_itr != full_statements.end(); ++s_itr) {
-			// Iterates through each text statement to find matching atomic substrings.
-			uint pos = 0;
-			while(pos < s_itr->getOrig().size()) {
-				pos = s_itr->getOrig().find(a_itr->first, pos);
-				if(pos < s_itr->getOrig().size()) {
-					++(*a_itr->second);
-					++pos;
+// Reads tags (batch tags first) and premises of one problem up to the '0' tag, solves it (or
+// finds it in cache, if given) and prints the result. Premises are parsed on jobs threads.
+static int runProblem(std::string_view tags, InputReader& in, std::ostream& out, std::ostream& err,
+					  const ResultCache* cache, uint jobs) {
+	InputReader tag_in(tags);
+	std::string_view in_stat; // Views into input, no copies made per token.
+	std::vector<std::string_view> stats;
+	Solver solver; // Premises parsed once by solver, all together after input is read.
+	solver.setJobs(jobs);
+	SolveOptions options;
+	bool count = false, models = false;
+	try {
+		while(tag_in.next(in_stat) || in.next(in_stat)) {
+			if(in_stat == "0") { break; } // Input termination tag.
+			if(in_stat == "-cnf") { // Use -cnf tag to switch to solving with clauses.
+				options.cnf = true;
+				continue;
+			}
+			if(in_stat == "-verdict") { // Use -verdict tag to only print consistency result.
+				options.verdict_only = true;
+				continue;
+			}
+			if(in_stat == "-jsonl") { // Use -jsonl tag to print structured tree instead of text encoding.
+				options.tree_format = TREE_JSONL;
+				continue;
+			}
+			if(in_stat == "-count") { // Use -count tag to print number of satisfying assignments.
+				count = true;
+				continue;
+			}
+			if(in_stat == "-models") { // Use -models tag to list satisfying assignments.
+				models = true;
+				continue;
+			}
+			/* Use -nodes, -time (milliseconds) or -output (bytes) tags followed by a number to limit
+			   search, -treenodes or -treedepth to limit nodes written in full to the output tree. */
+			if(in_stat == "-nodes" || in_stat == "-time" || in_stat == "-output" ||
+			   in_stat == "-treenodes" || in_stat == "-treedepth") {
+				std::string_view limit;
+				uint value = 0;
+				std::from_chars_result number;
+				if(tag_in.next(limit) || in.next(limit)) {
+					number = std::from_chars(limit.data(), limit.data()+limit.size(), value);
+				}
+				if(limit.empty() || number.ec != std::errc() || number.ptr != limit.data()+limit.size()) {
+					throw DPError("Expected number after " + std::string(in_stat));
 				}
+				if(in_stat == "-nodes") { options.max_nodes = value; }
+				else if(in_stat == "-time") { options.time_limit_ms = value; }
+				else if(in_stat == "-output") { options.max_output = value; }
+				else if(in_stat == "-treenodes") { options.tree_nodes = value; }
+				else { options.tree_depth = value; }
+				continue;
 			}
+			// Premise termination tag missing, should not occur through GUI.
+			if(in_stat.back() != ';') { throw DPError("Incomplete logic statement input."); }
+			in_stat.remove_suffix(1); // Remove ';' tag, whitespace inside premise ignored.
+			stats.push_back(in_stat);
 		}
-	}
-}
-
-// Generates text at current node in output tree encoding after each solving step.
-void write_output(const std::list<FullStatement>& full_statements, const std::string& curr_atom,
-				  std::vector<std::string>& output_tree, uint index) {
-	// Fills in blank elements as needed to maintain heap order in vector.
-	while(index+1 > output_tree.size()) { output_tree.push_back("# "); }
-	output_tree[index] = "-" + curr_atom; // Marking new branch with literal.
-	output_tree[index] += " #";
-	if(full_statements.empty()) { output_tree[index] += " [True]"; } // Open branch termination.
-	std::list<FullStatement>::const_iterator itr;
-	for(itr = full_statements.begin(); itr != full_statements.end(); ++itr) {
-		output_tree[index] += " " + itr->getOrig();
-	}
-}
-
-// Main solving function when keeping premises as original statements.
-bool dpSolve(const std::list<FullStatement>& full_statements, std::map<std::string,Atomic*>& atomics,
-			 std::vector<std::string>& output_tree, uint index, bool& solved) {
-	// Choose next atomic to set value based on highest number of occurances.
-	Atomic* curr_atom;
-	if(atomics.size()) {
-		curr_atom = atomics.begin()->second;
-		std::map<std::string,Atomic*>::iterator itr;
-		for(itr = ++atomics.begin(); itr != atomics.end(); ++itr) {
-			if(curr_atom->getQuantity() < itr->second->getQuantity()) {
-				curr_atom = itr->second;
+		if(in_stat != "0") { throw DPError("Input ended without 0 tag."); }
+		solver.addPremises(stats);
+		if(!solver.numPremises()) { throw DPError("No statements have been entered."); }
+		if(models) { // One line of literals per assignment, followed by their number, or unknown if cut short.
+			solver.enumerate(options);
+			for(uint i=0; i < solver.getModels().size(); ++i) {
+				std::map<std::string, bool>::const_iterator itr;
+				for(itr = solver.getModels()[i].begin(); itr != solver.getModels()[i].end(); ++itr) {
+					if(itr != solver.getModels()[i].begin()) { out << " "; }
+					out << (itr->second ? "" : "!") << itr->first;
+				}
+				out << std::endl;
 			}
+			if(solver.limitReached()) { out << "unknown" << std::endl; }
+			else { out << solver.getModels().size() << std::endl; }
+			return 0;
 		}
-	}
-	// Remove current atomic, it will not be needed deeper in recursive steps.
-	atomics.erase(curr_atom->getName());
-
-	// Set current atomic's value to true, evaluate statements based on this assumption.
-	bool true_branch = true;
-	curr_atom->setValue(true);
-	std::list<FullStatement> full_statements_copy; // Evaluate and recurse with statement copies.
-	std::list<FullStatement>::const_iterator c_itr;
-	for(c_itr = full_statements.begin(); c_itr != full_statements.end(); ++c_itr) {
-		full_statements_copy.push_back(FullStatement(*c_itr));
-	}
-	std::list<FullStatement>::iterator itr;
-	bool erase;
-	for(itr=full_statements_copy.begin(); itr != full_statements_copy.end(); erase ? itr : ++itr) {
-		erase = false;
-		if(itr->containsAtomic(curr_atom->getName())) {
-			itr->evaluate(curr_atom->getName());
-			// Terminate with closed branch if statement fully evaluated to 'false'.
-			if(itr->getValSet() && !itr->getVal()) { true_branch = false; }
-			// Delete statements that are fully evaluated to 'true'.
-			else if(itr->getValSet() && itr->getVal()) {
-				itr = full_statements_copy.erase(itr);
-				erase = true;
-			}
+		if(count) {
+			unsigned long long n = solver.count(options);
+			if(solver.limitReached()) { out << "unknown" << std::endl; }
+			else { out << n << std::endl; }
+			return 0;
 		}
+		// Will be true if open terminal branch, false if all branches close, 2 if a limit was reached.
+		Verdict consistent;
+		std::string tree;
+		std::map<std::string, bool> model;
+		if(!cache || !cache->load(solver, options, consistent, model, options.verdict_only ? NULL : &tree)) {
+			consistent = solver.solve(options);
+			if(!options.verdict_only) { tree = solver.getTree(); }
+			if(cache) { cache->store(solver, options, consistent); }
+		}
+		if(options.verdict_only) { out << consistent << std::endl; }
+		else if(options.tree_format == TREE_JSONL) {
+			out << tree << "{\"verdict\":" << consistent << "}" << std::endl;
+		} else {
+			out << tree << std::endl;
+			out << consistent << std::endl;
+		}
+	} catch(const DPError& e) {
+		err << "Error: " << e.what() << std::endl;
+		return 1;
 	}
-	recount(atomics, full_statements_copy); // Recount atomics after evaluation.
-	write_output(full_statements_copy, curr_atom->getName(), output_tree, index);
-	// Only recurse if unused atomics, branch is not closed, and remaining statements.
-	if(atomics.size() && true_branch && full_statements_copy.size()) {
-		true_branch = dpSolve(full_statements_copy, atomics, output_tree, 2*index+1, solved);
-	}
-	if(full_statements_copy.empty() || solved) { // Terminate open branch, immediate return.
-		solved = true;
-		atomics[curr_atom->getName()] = curr_atom;
-		return true;
-	}
+	return 0;
+}
 
-	// Set current atomic's value to false, evaluate statements based on this assumption.
-	// Same methods as above for evaluation and writing output.
-	++index;
-	bool false_branch = true;
-	curr_atom->setValue(false);
-	full_statements_copy.clear();
-	recount(atomics, full_statements);
-	for(c_itr = full_statements.begin(); c_itr != full_statements.end(); ++c_itr) {
-		full_statements_copy.push_back(FullStatement(*c_itr));
-	}
-	for(itr=full_statements_copy.begin(); itr != full_statements_copy.end(); erase ? itr : ++itr) {
-		erase = false;
-		if(itr->containsAtomic(curr_atom->getName())) {
-			itr->evaluate(curr_atom->getName());
-			if(itr->getValSet() && !itr->getVal()) { false_branch = false; }
-			else if(itr->getValSet() && itr->getVal()) {
-				itr = full_statements_copy.erase(itr);
-				erase = true;
-			}
-		}
+// Problem of a batch, output kept until written in input order.
+struct BatchProblem {
+	std::string id, output;
+	std::string_view text; // Into mapped file.
+	int status = 0;
+	bool done = false;
+};
+
+// Splits file into problems ended by '0' tag. Numbers after limit tags do not end a problem.
+static void splitProblems(InputReader& in, const std::string& id, std::vector<BatchProblem>& problems) {
+	uint first = problems.size();
+	std::string_view token;
+	const char* start = NULL;
+	bool value = false; // Token is number of preceding tag.
+	while(in.next(token)) {
+		if(!start) { start = token.data(); }
+		bool is_value = value;
+		value = token == "-nodes" || token == "-time" || token == "-output" || token == "-treenodes" ||
+				token == "-treedepth";
+		if(is_value || token != "0") { continue; }
+		problems.push_back(BatchProblem());
+		problems.back().text = std::string_view(start, token.data()+1-start);
+		start = NULL;
 	}
-	recount(atomics, full_statements_copy);
-	write_output(full_statements_copy, "!"+curr_atom->getName(), output_tree, index);
-	if(atomics.size() && false_branch && full_statements_copy.size()) {
-		false_branch = dpSolve(full_statements_copy, atomics, output_tree, 2*index+1, solved);
+	if(start) { // Last problem without '0' tag, reported as error.
+		problems.push_back(BatchProblem());
+		problems.back().text = std::string_view(start, token.data()+token.size()-start);
 	}
-	if(full_statements_copy.empty() || solved) {
-		solved = true;
-		atomics[curr_atom->getName()] = curr_atom;
-		return true;
+	// Files holding several problems number them.
+	for(uint i=first; i < problems.size(); ++i) {
+		problems[i].id = problems.size()-first > 1 ? id + ":" + std::to_string(i-first+1) : id;
 	}
-
-	// Reset current atomic so that it can be reused for different recursive branches.
-	curr_atom->unsetValue();
-	atomics[curr_atom->getName()] = curr_atom;
-	recount(atomics, full_statements);
-	return true_branch || false_branch;
 }
 
-// Converting heap vector into output string encoding solved tree graphic.
-void printTree(const std::vector<std::string>& output_tree, bool cnf) {
-	std::string output(output_tree[0]);
-	uint branch_index = 1;
-	int node;
-	for(uint i=1; i < output_tree.size(); ++i) {
-		// Create alternating lines of node statements and branches marked with literals.
-		if(i == branch_index) {
-			output += "\n";
-			branch_index = (branch_index+1)*2 - 1;
-			for(uint j=i; j < branch_index && j < output_tree.size(); ++j) {
-				// Case of blank branches/nodes.
-				if(output_tree[j] == "# ") { output += "- "; }
-				else {
-					node = output_tree[j].find('#');
-					// Prints literal on branch line.
-					output += output_tree[j].substr(0, node);
-				}
-			}
-			output += "\n";
+/* Solves every problem of a file or of each file in a directory (in name order) on a pool
+   of worker threads, each with its own solver. Results are written in input order, each
+   after a '== id' line, throughput follows on the error stream. */
+static int runBatch(const std::string& path, uint jobs, const std::string& tags, const ResultCache* cache) {
+	std::vector<BatchProblem> problems;
+	std::vector<std::unique_ptr<InputReader> > files; // Kept mapped until all are solved.
+	std::vector<std::string> names;
+	if(std::filesystem::is_directory(path)) {
+		for(const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(path)) {
+			if(entry.is_regular_file()) { names.push_back(entry.path().filename().string()); }
+		}
+		std::sort(names.begin(), names.end());
+		for(uint i=0; i < names.size(); ++i) {
+			files.push_back(std::unique_ptr<InputReader>(new InputReader(path + "/" + names[i])));
+			splitProblems(*files.back(), names[i], problems);
 		}
-		node = output_tree[i].find('#');
-		output += output_tree[i].substr(node); // Prints statements on node line.
-		if(output_tree[i] != "# ") { output += " "; }
+	} else {
+		files.push_back(std::unique_ptr<InputReader>(new InputReader(path)));
+		splitProblems(*files.back(), std::filesystem::path(path).filename().string(), problems);
+	}
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::atomic<uint> next(0);
+	std::mutex mutex;
+	std::condition_variable solved;
+	std::vector<std::thread> workers;
+	for(uint w=0; w < jobs; ++w) {
+		workers.push_back(std::thread([&]() {
+			for(uint i = next++; i < problems.size(); i = next++) {
+				InputReader in(problems[i].text);
+				std::ostringstream out;
+				int status = runProblem(tags, in, out, out, cache, 1); // Threads busy with other problems.
+				std::lock_guard<std::mutex> lock(mutex);
+				problems[i].output = out.str();
+				problems[i].status = status;
+				problems[i].done = true;
+				solved.notify_all();
+			}
+		}));
+	}
+	uint failed = 0;
+	for(uint i=0; i < problems.size(); ++i) {
+		std::unique_lock<std::mutex> lock(mutex);
+		solved.wait(lock, [&]() { return problems[i].done; });
+		std::string output;
+		output.swap(problems[i].output); // Released once written.
+		lock.unlock();
+		std::cout << "== " << problems[i].id << "\n" << output << std::flush;
+		if(problems[i].status) { ++failed; }
 	}
-	output += "\nend"; // Terminating tag.
-	std::cout << output << std::endl;
+	for(uint w=0; w < workers.size(); ++w) { workers[w].join(); }
+	double secs = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+	std::cerr << problems.size() << " problems (" << failed << " failed) in " << secs << " s, "
+			  << (secs > 0 ? problems.size()/secs : 0) << " problems/s on " << jobs << " threads" << std::endl;
+	return failed ? 1 : 0;
 }
 
-int main() {
-	std::string in_stat;
-	std::list<FullStatement> full_statements;
-	std::map<std::string,Atomic*> atomics;
-	// Used for checking input, accepts operator shortcuts, letters, and parentheses.
-	std::string valid_chars("!&|$%()ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz");
-	bool cnf = false;
-	std::cin >> in_stat;
-	while(in_stat != "0") { // Input termination tag.
-		if(in_stat == "-cnf") { // Use -cnf tag to switch to solving with clauses.
-			cnf = true;
-			std::cin >> in_stat;
-			continue;
+/* Reads a single problem from standard input, parsing premises on --jobs N threads. With
+   --batch FILE|DIR [--jobs N], solves many problems on N threads; other arguments are input
+   tags applied to every problem of the batch. With --trace FILE, a timeline of search nodes
+   and simplification steps is written to FILE in Chrome trace format. With --cache DIR
+   [--cache-size MB], results are kept in DIR and repeated problems are not solved again. */
+int main(int argc, char* argv[]) {
+	std::string batch, tags, trace, cache_dir;
+	uint jobs = std::max(1u, std::thread::hardware_concurrency());
+	uintmax_t cache_mb = 64;
+	for(int i=1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if((arg == "--batch" || arg == "--jobs" || arg == "--trace" || arg == "--cache" ||
+			arg == "--cache-size") && i+1 >= argc) {
+			std::cerr << "Error: Missing value after " << arg << std::endl;
+			return 1;
 		}
-		if(in_stat.back() != ';') { // Premise termination tag.
-			std::string in_stat_more;
-			// Keep reading in input until tag is reached. Allows for optional whitespace.
-			while(std::cin >> in_stat_more) {
-				in_stat += in_stat_more;
-				if(in_stat.back() == ';') { break; }
-			}
-		}
-		// Premise termination tag missing, should not occur through GUI.
-		if(in_stat.back() != ';') {
-			std::cerr << "Error: Incomplete logic statement input." << std::endl;
-			exit(1);
-		}
-		if(in_stat.size() == 1) { // Empty input line case.
-			std::cerr << "Error: Blank statement entered." << std::endl;
-			exit(1);
-		}
-		in_stat.pop_back(); // Remove ';' tag.
-		int left_par=0;
-		int right_par=0;
-		for(uint i=0; i<in_stat.size(); ++i) {
-			if(in_stat[i] == '~') { in_stat[i] = '!'; } // Allows either negation shortcut.
-			// Check that all input uses valid characters.
-			if(valid_chars.find(in_stat[i]) > valid_chars.size()) {
-				std::cerr << "Error: Invalid characters in " << in_stat << std::endl;
-				exit(1);
-			}
-			// No atomics or closing parenthesis preceding opening parentheis.
-			if(in_stat[i]=='(') {
-				if(i>0 && !(in_stat[i-1]=='&' || in_stat[i-1]=='|' || in_stat[i-1]=='$' ||
-				  in_stat[i-1]=='%' || in_stat[i-1]=='(' || in_stat[i-1]=='!')) {
-					std::cerr << "Error: Improper logic expression: " << in_stat << std::endl;
-					exit(1);
-				}
-				++left_par; }
-			// No atomics or opening parenthesis following closing parentheis.
-			if(in_stat[i]==')') {
-				if(i+1 < in_stat.size() && !(in_stat[i+1]=='&' || in_stat[i+1]=='|' ||
-				  in_stat[i+1]=='$' || in_stat[i+1]=='%' || in_stat[i+1]==')')) {
-					std::cerr << "Error: Improper logic expression: " << in_stat << std::endl;
-					exit(1);
-				} // Number of closing parentheses can never exceed opening parentheses.
-				if(left_par <= right_par) {
-					std::cerr << "Error: Mismatched parentheses in " << in_stat << std::endl;
-					exit(1);
-				}
-				++right_par;
-			}
-		}
-		if(left_par != right_par) {
-			std::cerr << "Error: Mismatched parentheses in " << in_stat << std::endl;
-			exit(1);
-		}
-		full_statements.push_back(FullStatement(in_stat, atomics));
-		std::cin >> in_stat;
+		if(arg == "--batch") { batch = argv[++i]; }
+		else if(arg == "--jobs") { jobs = std::max(1, atoi(argv[++i])); }
+		else if(arg == "--trace") { trace = argv[++i]; }
+		else if(arg == "--cache") { cache_dir = argv[++i]; }
+		else if(arg == "--cache-size") { cache_mb = std::max(1, atoi(argv[++i])); }
+		else { tags += arg + " "; }
 	}
-	if(full_statements.empty()) {
-		std::cerr << "Error: No statements have been entered." << std::endl;
-		exit(1);
+	if(batch.empty() && !tags.empty()) {
+		std::cerr << "Error: Input tags as arguments need --batch." << std::endl;
+		return 1;
 	}
-	bool consistent; // Will be true if open terminal branch, false if all branches close.
-	if(cnf) {
-		// Convert statements into CNF and then clauses if requested.
-		ClauseSet clause_set(full_statements);
-		consistent = clause_set.evaluate({"",true}, 0);
-		printTree(clause_set.getOutput(), cnf);
-	} else { // Solving with original statements.
-		// Load output string encoding with original statements as root.
-		std::vector<std::string> output_tree(1, "#");
-		std::list<FullStatement>::iterator c_itr;
-		for(c_itr = full_statements.begin(); c_itr != full_statements.end(); ++c_itr) {
-			output_tree[0] += " " + c_itr->getOrig();
-		}
-		bool solved = false; // Allows immediate return after terminating open branch.
-		consistent = dpSolve(full_statements, atomics, output_tree, 1, solved);
-		printTree(output_tree, cnf);
+	if(!trace.empty()) { Trace::start(); }
+	int status;
+	try {
+		std::unique_ptr<ResultCache> cache;
+		if(!cache_dir.empty()) { cache.reset(new ResultCache(cache_dir, cache_mb << 20)); }
+		if(batch.empty()) {
+			InputReader in;
+			status = runProblem("", in, std::cout, std::cerr, cache.get(), jobs);
+		} else { status = runBatch(batch, jobs, tags, cache.get()); }
+		if(!trace.empty()) { Trace::write(trace); }
+	} catch(const std::exception& e) {
+		std::cerr << "Error: " << e.what() << std::endl;
+		return 1;
 	}
-	std::cout << consistent << std::endl;
-	// Deallocate dynamic memory containing atomic objects.
-	std::map<std::string,Atomic*>::iterator itr;
-	for(itr = atomics.begin(); itr != atomics.end(); ++itr) { delete itr->second; }
-	return 0;
+	return status;
 }
\ No newline at end of file
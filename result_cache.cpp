@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "davis_putnam.h"
+
+static const std::string CACHE_HEADER = "dptrees-cache 1";
+
+// Makes cache directory if missing, reads its size.
+ResultCache::ResultCache(const std::string& dir, uintmax_t max_bytes) : dir(dir), max_bytes(max_bytes) {
+	std::error_code ec;
+	std::filesystem::create_directories(dir, ec);
+	if(!std::filesystem::is_directory(dir)) { throw DPError("Cannot use cache directory " + dir); }
+	if(max_bytes) { total = evict(); }
+}
+
+// 64-bit FNV-1a hash.
+uint64_t ResultCache::hash(const std::string& text) {
+	uint64_t h = 14695981039346656037ULL;
+	for(uint i=0; i < text.size(); ++i) {
+		h ^= (unsigned char)text[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+// Entry file of key, 'r' for results and 't' for trees.
+std::string ResultCache::entryPath(char kind, const std::string& key) const {
+	char name[24];
+	snprintf(name, sizeof(name), "%c-%016llx", kind, (unsigned long long)hash(key));
+	return dir + "/" + name;
+}
+
+/* Entry file: header line, full key (checked, so colliding hashes are misses), then value.
+   Reading an entry marks it as used for eviction. */
+bool ResultCache::read(const std::string& path, const std::string& key, std::string& value) const {
+	std::ifstream in(path, std::ios::binary);
+	std::string header, entry_key;
+	if(!in || !std::getline(in, header) || header != CACHE_HEADER || !std::getline(in, entry_key) ||
+	   entry_key != key) { return false; }
+	std::ostringstream rest;
+	rest << in.rdbuf();
+	value = rest.str();
+	std::error_code ec;
+	std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+	return true;
+}
+
+/* Writes entry to a temporary file of its own, then renames it over the entry, so readers in
+   other processes see either the old or the new entry whole. Adds change in size to total. */
+void ResultCache::write(const std::string& path, const std::string& key, const std::string& value) const {
+	static std::atomic<uint> counter(0);
+	std::ostringstream tmp;
+	tmp << dir << "/tmp-" << std::hash<std::thread::id>()(std::this_thread::get_id()) << "-"
+		<< std::chrono::steady_clock::now().time_since_epoch().count() << "-" << counter++;
+	{
+		std::ofstream out(tmp.str(), std::ios::binary);
+		out << CACHE_HEADER << "\n" << key << "\n" << value;
+		if(!out) { // Cache is best effort, solving goes on without it.
+			out.close();
+			std::error_code ec;
+			std::filesystem::remove(tmp.str(), ec);
+			return;
+		}
+	}
+	std::error_code ec;
+	uintmax_t replaced = std::filesystem::file_size(path, ec);
+	if(ec) { replaced = 0; }
+	std::filesystem::rename(tmp.str(), path, ec);
+	if(ec) {
+		std::filesystem::remove(tmp.str(), ec);
+		return;
+	}
+	std::lock_guard<std::mutex> lock(total_mutex);
+	total += CACHE_HEADER.size() + key.size() + value.size() + 2;
+	total -= std::min(total, replaced);
+}
+
+/* Removes least recently used entries once the directory is past max_bytes, down to 90% of
+   it, so a full cache is not listed again on the next store. Returns size of directory. */
+uintmax_t ResultCache::evict() const {
+	std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path> > entries;
+	uintmax_t bytes = 0;
+	std::error_code ec;
+	for(std::filesystem::directory_iterator d_itr(dir, ec), end; !ec && d_itr != end; d_itr.increment(ec)) {
+		uintmax_t size = d_itr->file_size(ec);
+		if(ec) { continue; } // Removed by another process.
+		bytes += size;
+		entries.push_back({d_itr->last_write_time(ec), d_itr->path()});
+	}
+	if(bytes <= max_bytes) { return bytes; }
+	std::sort(entries.begin(), entries.end());
+	for(uint i=0; i < entries.size() && bytes > max_bytes - max_bytes/10; ++i) {
+		uintmax_t size = std::filesystem::file_size(entries[i].second, ec);
+		if(!ec && std::filesystem::remove(entries[i].second, ec)) { bytes -= size; }
+	}
+	return bytes;
+}
+
+// Key of tree: premises as entered and options shaping the tree.
+static std::string treeKey(const Solver& solver, const SolveOptions& options) {
+	return std::to_string(options.cnf) + " " + std::to_string(options.tree_format) + " " +
+		   std::to_string(options.tree_nodes) + " " + std::to_string(options.tree_depth) + " " +
+		   solver.premiseText();
+}
+
+/* Result entry holds verdict and model with atomics by canonical number ("1 0 !1 2"), tree
+   entry holds tree text. Budgets take no part in keys, since only complete results are
+   stored: unknown verdicts are not stored, nor trees cut short after an open branch. */
+bool ResultCache::load(const Solver& solver, const SolveOptions& options, Verdict& verdict,
+					   std::map<std::string, bool>& model, std::string* tree) const {
+	std::vector<std::string> names;
+	std::string key = solver.canonicalText(names), value;
+	if(!read(entryPath('r', key), key, value)) { return false; }
+	std::istringstream in(value);
+	int v;
+	if(!(in >> v) || (v != CONSISTENT && v != INCONSISTENT)) { return false; }
+	std::map<std::string, bool> cached;
+	std::string lit;
+	while(in >> lit) {
+		bool neg = lit[0] == '!';
+		uint id = atoi(lit.c_str()+neg);
+		if(id >= names.size()) { return false; }
+		cached[names[id]] = !neg;
+	}
+	if(tree) {
+		std::string tree_key = treeKey(solver, options);
+		if(!read(entryPath('t', tree_key), tree_key, value)) { return false; }
+		*tree = value;
+	}
+	verdict = Verdict(v);
+	model.swap(cached);
+	return true;
+}
+
+void ResultCache::store(const Solver& solver, const SolveOptions& options, Verdict verdict) const {
+	if(verdict == UNKNOWN) { return; }
+	std::vector<std::string> names;
+	std::string key = solver.canonicalText(names);
+	std::string value = std::to_string(verdict);
+	for(uint i=0; i < names.size() && verdict == CONSISTENT; ++i) {
+		std::map<std::string, bool>::const_iterator m_itr = solver.getModel().find(names[i]);
+		if(m_itr != solver.getModel().end()) { value += (m_itr->second ? " " : " !") + std::to_string(i); }
+	}
+	write(entryPath('r', key), key, value + "\n");
+	// Verdict found before a budget ran out is complete, tree written so far is not.
+	if(!options.verdict_only && !solver.limitReached()) {
+		std::string tree_key = treeKey(solver, options);
+		write(entryPath('t', tree_key), tree_key, solver.getTree());
+	}
+	// Directory is only listed once stores take it past max_bytes.
+	std::lock_guard<std::mutex> lock(total_mutex);
+	if(max_bytes && total > max_bytes) { total = evict(); }
+}
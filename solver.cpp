@@ -0,0 +1,940 @@
+#include <algorithm>
+#include <exception>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <thread>
+#include <unordered_map>
+#include "davis_putnam.h"
+
+// Updates quantities of atomic statements after each solving step.
+void recount(std::map<std::string,Atomic*>& atomics, const std::list<FullStatement>& full_statements) {
+	std::map<std::string,Atomic*>::iterator a_itr;
+	for(a_itr = atomics.begin(); a_itr != atomics.end(); ++a_itr) { a_itr->second->resetQuantity(); }
+	// Counts leaf nodes of each statement tree instead of searching its text.
+	std::list<FullStatement>::const_iterator s_itr;
+	for(s_itr = full_statements.begin(); s_itr != full_statements.end(); ++s_itr) {
+		s_itr->countAtomics();
+	}
+}
+
+// Generates text at current node in output tree encoding after each solving step.
+void write_output(const std::list<FullStatement>& full_statements, const std::string& curr_atom,
+				  std::vector<std::string>& output_tree, uint index) {
+	// Fills in blank elements as needed to maintain heap order in vector.
+	while(index+1 > output_tree.size()) { output_tree.push_back("# "); }
+	output_tree[index] = "-" + curr_atom; // Marking new branch with literal.
+	output_tree[index] += " #";
+	if(full_statements.empty()) { output_tree[index] += " [True]"; } // Open branch termination.
+	std::list<FullStatement>::const_iterator itr;
+	for(itr = full_statements.begin(); itr != full_statements.end(); ++itr) {
+		output_tree[index] += " " + itr->getOrig();
+	}
+}
+
+// Adds 2^exp to count, model counts are exact or rejected.
+static void addPower(unsigned long long& count, uint exp) {
+	if(exp >= 64 || count > ~0ULL - (1ULL << exp)) { throw DPError("Model count exceeds 64 bits."); }
+	count += 1ULL << exp;
+}
+
+// Starts clock for time limit.
+SearchLimits::SearchLimits(const SolveOptions& options, std::atomic<bool>* cancel)
+	: cancel_(cancel), max_nodes(options.max_nodes), max_output(options.max_output),
+	  timed(options.time_limit_ms != 0) {
+	deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.time_limit_ms);
+}
+
+// Counts search node, returns true once any budget is used up or solve is cancelled.
+bool SearchLimits::exceeded() {
+	if(reached_) { return true; }
+	++nodes;
+	if(cancel_ && cancel_->load(std::memory_order_relaxed)) { reached_ = true; }
+	else if(max_nodes && nodes > max_nodes) { reached_ = true; }
+	else if(max_output && output > max_output) { reached_ = true; }
+	// Clock only read every 16 nodes.
+	else if(timed && !(nodes & 15) && std::chrono::steady_clock::now() >= deadline) { reached_ = true; }
+	return reached_;
+}
+
+/* Returns true once solve is cancelled or out of time, without counting a node. For long steps
+   before and within nodes, also called by threads converting premises. */
+bool SearchLimits::interrupted() {
+	if(reached_) { return true; }
+	if((cancel_ && cancel_->load(std::memory_order_relaxed)) ||
+	   (timed && std::chrono::steady_clock::now() >= deadline)) { reached_ = true; }
+	return reached_;
+}
+
+// Records open branch, free atomics not on trail double the number of assignments covered.
+void SearchState::openBranch(uint free_atoms) {
+	solved = true;
+	if(!all) {
+		if(!cubes.empty()) { return; }
+		cubes.push_back(trail); // First open branch is the model.
+		// Substituted literals take value of their equals, latest substitution first.
+		std::vector<Literal>& cube = cubes.back();
+		for(uint i=equiv.size(); i-- > 0; ) {
+			const Literal& rep = equiv[i].second;
+			uint j = 0;
+			while(j < cube.size() && cube[j].first != rep.first) { ++j; }
+			if(j == cube.size()) { cube.push_back(rep); } // Free, either value works.
+			bool val = cube[j].second == rep.second;
+			cube.push_back({equiv[i].first.first, equiv[i].first.second == val});
+		}
+		return;
+	}
+	addPower(count, free_atoms);
+	if(keep_cubes) {
+		cubes.push_back(trail);
+		if(max_cubes && cubes.size() >= max_cubes) { stop = true; }
+	}
+}
+
+// Counts node one level below current. Returns true if its subtree is past the level of
+// detail budget, then only a summary of it is written.
+bool SearchState::beginNode() {
+	++nodes;
+	if(depth+1 > max_depth) { max_depth = depth+1; }
+	if(!write || (!tree_nodes && !tree_depth)) { return false; }
+	// Heap order of output tree needs bounded depth to bound its size.
+	uint depth_limit = tree_depth ? tree_depth : 16;
+	if((!tree_nodes || written < tree_nodes) && depth+1 <= depth_limit) {
+		++written;
+		return false;
+	}
+	write = false;
+	collapse_nodes = nodes-1;
+	max_depth = depth+1;
+	return true;
+}
+
+// Ends collapsed subtree, writes its summary: open or closed, node count, and depth.
+void SearchState::endCollapse(bool open, const std::string& lit, std::vector<std::string>& output_tree,
+							  uint index) {
+	write = true;
+	if(record) {
+		record->summary(parent, lit, open, nodes-collapse_nodes, max_depth-depth);
+		wroteRecord();
+		return;
+	}
+	write_summary(std::string(open ? "[Open:" : "[Closed:") + "n=" + std::to_string(nodes-collapse_nodes) +
+				  ",d=" + std::to_string(max_depth-depth) + "]", lit, output_tree, index);
+	wrote(output_tree[index].size());
+}
+
+// Writes summary in place of collapsed subtree's node text, same encoding as write_output.
+void write_summary(const std::string& summary, const std::string& curr_atom,
+				   std::vector<std::string>& output_tree, uint index) {
+	while(index+1 > output_tree.size()) { output_tree.push_back("# "); }
+	output_tree[index] = "-" + curr_atom + " # " + summary;
+}
+
+// Structured version of write_output(), statements referred to by formula id. Returns node id.
+static uint record_output(const std::list<FullStatement>& full_statements, const std::string& curr_atom,
+						  SearchState& state) {
+	std::vector<uint> ids;
+	std::list<FullStatement>::const_iterator itr;
+	for(itr = full_statements.begin(); itr != full_statements.end(); ++itr) {
+		ids.push_back(state.record->formula(itr->getOrig()));
+	}
+	uint id = state.record->node(state.parent, curr_atom, ids);
+	state.wroteRecord();
+	return id;
+}
+
+/* Copies statements with atomic set to value, deleting those made true. Statements left as a
+   single literal force their atomic the same way until none remain; forced atomics are taken
+   out of atomics and added to the branch label and trail. Returns false if a statement is false. */
+static bool assignStatements(const std::list<FullStatement>& full_statements, Atomic* atom, bool value,
+							 std::map<std::string,Atomic*>& atomics, std::list<FullStatement>& full_statements_copy,
+							 std::vector<Atomic*>& forced, std::string& label, SearchState& state) {
+	full_statements_copy.clear();
+	std::list<FullStatement>::const_iterator c_itr;
+	for(c_itr = full_statements.begin(); c_itr != full_statements.end(); ++c_itr) {
+		full_statements_copy.push_back(FullStatement(*c_itr));
+	}
+	atom->setValue(value);
+	label = (value ? "" : "!") + atom->getName();
+	bool open = true;
+	while(true) {
+		std::list<FullStatement>::iterator itr;
+		bool erase;
+		for(itr=full_statements_copy.begin(); itr != full_statements_copy.end(); erase ? itr : ++itr) {
+			erase = false;
+			if(itr->containsAtomic(atom)) {
+				itr->evaluate(atom, state.write);
+				// Terminate with closed branch if statement fully evaluated to 'false'.
+				if(itr->getValSet() && !itr->getVal()) { open = false; }
+				// Delete statements that are fully evaluated to 'true'.
+				else if(itr->getValSet() && itr->getVal()) {
+					itr = full_statements_copy.erase(itr);
+					erase = true;
+				}
+			}
+		}
+		if(!open) { return false; }
+		Literal lit;
+		for(itr=full_statements_copy.begin(); itr != full_statements_copy.end() && !itr->isLiteral(lit); ++itr) {}
+		if(itr == full_statements_copy.end()) { return true; }
+		atom = itr->getAtomics()[0];
+		atomics.erase(lit.first);
+		forced.push_back(atom);
+		atom->setValue(lit.second);
+		state.trail.push_back(lit);
+		label += "," + std::string(lit.second ? "" : "!") + lit.first;
+	}
+}
+
+// Main solving function when keeping premises as original statements.
+bool dpSolve(const std::list<FullStatement>& full_statements, std::map<std::string,Atomic*>& atomics,
+			 std::vector<std::string>& output_tree, uint index, SearchState& state) {
+	if(state.limitReached()) { return false; }
+	uint parent = state.parent; // Record id of node these branches come from.
+	uint node = parent;
+	// A statement that is a single literal forces its atomic, only that branch is made.
+	Literal unit;
+	std::list<FullStatement>::const_iterator c_itr;
+	for(c_itr = full_statements.begin(); c_itr != full_statements.end() && !c_itr->isLiteral(unit); ++c_itr) {}
+	bool forced_unit = c_itr != full_statements.end();
+	// Otherwise choose next atomic to set value based on highest number of occurances.
+	Atomic* curr_atom = forced_unit ? c_itr->getAtomics()[0] : atomics.begin()->second;
+	std::map<std::string,Atomic*>::iterator a_itr;
+	for(a_itr = ++atomics.begin(); !forced_unit && a_itr != atomics.end(); ++a_itr) {
+		if(curr_atom->getQuantity() < a_itr->second->getQuantity()) {
+			curr_atom = a_itr->second;
+		}
+	}
+	// Remove current atomic, it will not be needed deeper in recursive steps.
+	atomics.erase(curr_atom->getName());
+	uint trail_size = state.trail.size();
+	std::list<FullStatement> full_statements_copy; // Evaluate and recurse with statement copies.
+	std::vector<Atomic*> forced; // Atomics forced on current branch.
+	std::string label; // Literals set on current branch.
+
+	// Set current atomic's value to true, evaluate statements based on this assumption.
+	bool true_branch = false;
+	if(!forced_unit || unit.second) {
+		TraceScope trace("node", state.depth+1);
+		bool collapsed = state.beginNode(); // Subtree without text past level of detail budget.
+		state.trail.push_back({curr_atom->getName(), true});
+		true_branch = assignStatements(full_statements, curr_atom, true, atomics, full_statements_copy,
+									   forced, label, state);
+		if(trace.active()) {
+			trace.lit = label;
+			trace.size = full_statements_copy.size();
+		}
+		recount(atomics, full_statements_copy); // Recount atomics after evaluation.
+		if(state.write && state.record) { node = record_output(full_statements_copy, label, state); }
+		else if(state.write) {
+			write_output(full_statements_copy, label, output_tree, index);
+			state.wrote(output_tree[index].size());
+		}
+		// Only recurse if unused atomics, branch is not closed, and remaining statements.
+		if(atomics.size() && true_branch && full_statements_copy.size()) {
+			++state.depth;
+			state.parent = node;
+			true_branch = dpSolve(full_statements_copy, atomics, output_tree, 2*index+1, state);
+			state.parent = parent;
+			--state.depth;
+		}
+		if(full_statements_copy.empty()) { state.openBranch(atomics.size()); }
+		state.trail.resize(trail_size);
+		// Forced atomics are free again on other branches.
+		for(uint i=0; i < forced.size(); ++i) {
+			forced[i]->unsetValue();
+			atomics[forced[i]->getName()] = forced[i];
+		}
+		forced.clear();
+		if(collapsed) { state.endCollapse(true_branch, label, output_tree, index); }
+		if((state.solved && !state.all) || state.stop) { // Terminate open branch, immediate return.
+			atomics[curr_atom->getName()] = curr_atom;
+			return true;
+		}
+	}
+
+	// Set current atomic's value to false, evaluate statements based on this assumption.
+	// Same methods as above for evaluation and writing output.
+	++index;
+	bool false_branch = false;
+	if(!forced_unit || !unit.second) {
+		TraceScope trace("node", state.depth+1);
+		bool collapsed = state.beginNode();
+		state.trail.push_back({curr_atom->getName(), false});
+		recount(atomics, full_statements);
+		false_branch = assignStatements(full_statements, curr_atom, false, atomics, full_statements_copy,
+										forced, label, state);
+		if(trace.active()) {
+			trace.lit = label;
+			trace.size = full_statements_copy.size();
+		}
+		recount(atomics, full_statements_copy);
+		if(state.write && state.record) { node = record_output(full_statements_copy, label, state); }
+		else if(state.write) {
+			write_output(full_statements_copy, label, output_tree, index);
+			state.wrote(output_tree[index].size());
+		}
+		if(atomics.size() && false_branch && full_statements_copy.size()) {
+			++state.depth;
+			state.parent = node;
+			false_branch = dpSolve(full_statements_copy, atomics, output_tree, 2*index+1, state);
+			state.parent = parent;
+			--state.depth;
+		}
+		if(full_statements_copy.empty()) { state.openBranch(atomics.size()); }
+		state.trail.resize(trail_size);
+		for(uint i=0; i < forced.size(); ++i) {
+			forced[i]->unsetValue();
+			atomics[forced[i]->getName()] = forced[i];
+		}
+		if(collapsed) { state.endCollapse(false_branch, label, output_tree, index); }
+		if((state.solved && !state.all) || state.stop) {
+			atomics[curr_atom->getName()] = curr_atom;
+			return true;
+		}
+	}
+
+	// Reset current atomic so that it can be reused for different recursive branches.
+	curr_atom->unsetValue();
+	atomics[curr_atom->getName()] = curr_atom;
+	recount(atomics, full_statements);
+	return true_branch || false_branch;
+}
+
+// Groups units (statements or clauses) that share atomics, returns component of each unit.
+static std::vector<uint> components(const std::vector<std::vector<std::string> >& unit_atoms) {
+	std::vector<uint> parent(unit_atoms.size());
+	for(uint i=0; i < parent.size(); ++i) { parent[i] = i; }
+	std::map<std::string, uint> first; // First unit containing each atomic.
+	for(uint i=0; i < unit_atoms.size(); ++i) {
+		for(uint j=0; j < unit_atoms[i].size(); ++j) {
+			std::map<std::string, uint>::iterator f_itr = first.find(unit_atoms[i][j]);
+			if(f_itr == first.end()) {
+				first[unit_atoms[i][j]] = i;
+				continue;
+			}
+			// Union of both units' roots.
+			uint a = i, b = f_itr->second;
+			while(parent[a] != a) { a = parent[a] = parent[parent[a]]; }
+			while(parent[b] != b) { b = parent[b] = parent[parent[b]]; }
+			if(a != b) { parent[std::max(a,b)] = std::min(a,b); }
+		}
+	}
+	// Number components in order of first unit.
+	std::vector<uint> comp(unit_atoms.size());
+	std::map<uint, uint> numbers;
+	for(uint i=0; i < unit_atoms.size(); ++i) {
+		uint r = i;
+		while(parent[r] != r) { r = parent[r]; }
+		if(numbers.find(r) == numbers.end()) {
+			uint n = numbers.size();
+			numbers[r] = n;
+		}
+		comp[i] = numbers[r];
+	}
+	return comp;
+}
+
+// Adds atomics of statement that have no value set yet.
+static void unsetAtomics(const FullStatement& fs, std::map<std::string,Atomic*>& atoms) {
+	std::vector<Atomic*> fs_atoms = fs.getAtomics();
+	for(uint i=0; i < fs_atoms.size(); ++i) {
+		if(!fs_atoms[i]->isSet()) { atoms.insert({fs_atoms[i]->getName(), fs_atoms[i]}); }
+	}
+}
+
+// Deallocate dynamic memory containing atomic objects.
+Solver::~Solver() {
+	for(uint i=0; i < cut_short.size(); ++i) { delete cut_short[i]; }
+	std::map<std::string,Atomic*>::iterator itr;
+	for(itr = atomics.begin(); itr != atomics.end(); ++itr) { delete itr->second; }
+}
+
+// Runs work(i) for each i below n on up to jobs threads, calling thread included.
+template <class Work>
+static void parallelFor(uint n, uint jobs, Work work) {
+	std::atomic<uint> next(0);
+	auto run = [&]() {
+		for(uint i = next++; i < n; i = next++) { work(i); }
+	};
+	std::vector<std::thread> workers;
+	for(uint w=1; w < std::min(jobs, n); ++w) { workers.push_back(std::thread(run)); }
+	run();
+	for(uint w=0; w < workers.size(); ++w) { workers[w].join(); }
+}
+
+// Throws first error found, errors of later premises are not reported.
+static void rethrowFirst(const std::vector<std::exception_ptr>& errors) {
+	for(uint i=0; i < errors.size(); ++i) {
+		if(errors[i]) { std::rethrow_exception(errors[i]); }
+	}
+}
+
+// Validates premise, then parses it into the current frame.
+void Solver::addPremise(std::string_view raw_stat) {
+	addPremises(std::vector<std::string_view>(1, raw_stat));
+}
+
+/* Same as adding each premise in order, with validation, parsing and simplification done on
+   worker threads (see setJobs()). Atomics are added to the solver first in order of
+   appearance, so parsing only reads the shared map. Nothing is added if any premise is
+   invalid. */
+void Solver::addPremises(const std::vector<std::string_view>& raw_stats) {
+	uint n = raw_stats.size();
+	std::vector<std::string> stats(n);
+	std::vector<std::exception_ptr> errors(n);
+	parallelFor(n, jobs, [&](uint i) {
+		try {
+			stats[i].reserve(raw_stats[i].size());
+			for(uint j=0; j < raw_stats[i].size(); ++j) {
+				if(!(char_class[(unsigned char)raw_stats[i][j]] & CH_SPACE)) { stats[i] += raw_stats[i][j]; }
+			}
+			checkStatement(stats[i]);
+		} catch(...) { errors[i] = std::current_exception(); }
+	});
+	rethrowFirst(errors);
+	for(uint i=0; i < n; ++i) {
+		for(uint j=0; j < stats[i].size(); ) {
+			if(!(char_class[(unsigned char)stats[i][j]] & CH_LETTER)) {
+				++j;
+				continue;
+			}
+			uint k = j;
+			while(k < stats[i].size() && (char_class[(unsigned char)stats[i][k]] & CH_LETTER)) { ++k; }
+			std::string atom = stats[i].substr(j, k-j);
+			if(atomics.find(atom) == atomics.end()) { atomics[atom] = new Atomic(atom, atomics.size()); }
+			j = k;
+		}
+	}
+	// Each premise parsed into a list of its own, spliced in order afterward.
+	std::vector<std::list<FullStatement> > parsed(n);
+	std::vector<std::vector<std::string> > atom_names(n);
+	std::vector<std::string> keys(n);
+	parallelFor(n, jobs, [&](uint i) {
+		try {
+			parsed[i].emplace_back(stats[i], atomics);
+			std::vector<Atomic*> atoms = parsed[i].back().getAtomics();
+			for(uint j=0; j < atoms.size(); ++j) { atom_names[i].push_back(atoms[j]->getName()); }
+			keys[i] = parsed[i].back().normalize();
+		} catch(...) { errors[i] = std::current_exception(); }
+	});
+	rethrowFirst(errors);
+	for(uint i=0; i < n; ++i) {
+		premises.splice(premises.end(), parsed[i]);
+		premise_atoms.push_back(std::vector<std::string>());
+		premise_atoms.back().swap(atom_names[i]);
+		// Premises always true or repeating an earlier one (up to operand order) are not solved.
+		uint p = premises.size()-1;
+		if(premises.back().getValSet() && premises.back().getVal()) { sources.push_back(-1); }
+		else if(canonical.find(keys[i]) != canonical.end()) { sources.push_back(canonical[keys[i]]); }
+		else {
+			canonical[keys[i]] = p;
+			sources.push_back(p);
+		}
+	}
+}
+
+// Removes all premises added since the matching push().
+void Solver::pop() {
+	if(frames.empty()) { throw DPError("pop() without matching push()."); }
+	while(premises.size() > frames.back()) {
+		if(premise_clauses.size() == premises.size()) { premise_clauses.pop_back(); }
+		premises.pop_back();
+		premise_atoms.pop_back();
+		sources.pop_back();
+	}
+	std::unordered_map<std::string, uint>::iterator k_itr;
+	for(k_itr = canonical.begin(); k_itr != canonical.end(); ) {
+		if(k_itr->second >= frames.back()) { k_itr = canonical.erase(k_itr); }
+		else { ++k_itr; }
+	}
+	frames.pop_back();
+}
+
+// Returns true if some atomic is assumed both true and false.
+static bool conflicting(const std::vector<Literal>& assumptions) {
+	std::map<std::string, bool> assumed;
+	for(uint i=0; i < assumptions.size(); ++i) {
+		std::map<std::string, bool>::iterator a_itr = assumed.insert(assumptions[i]).first;
+		if(a_itr->second != assumptions[i].second) { return true; }
+	}
+	return false;
+}
+
+/* Copies current premises and evaluates them under assumptions, premises stay reusable.
+   Returns false if an assumption makes a premise false or assumptions contradict. */
+bool Solver::loadStatements(const std::vector<Literal>& assumptions, bool write,
+							std::list<FullStatement>& full_statements) {
+	std::map<std::string,Atomic*>::iterator a_itr;
+	for(a_itr = atomics.begin(); a_itr != atomics.end(); ++a_itr) { a_itr->second->unsetValue(); }
+	full_statements.clear();
+	std::list<FullStatement>::const_iterator p_itr = premises.begin();
+	for(uint i=0; p_itr != premises.end(); ++p_itr, ++i) {
+		if(sources[i] != int(i)) { continue; }
+		if(p_itr->getValSet()) { return false; } // Always false.
+		full_statements.push_back(*p_itr);
+	}
+	if(conflicting(assumptions)) { return false; }
+	bool open = true;
+	for(uint i=0; i < assumptions.size(); ++i) {
+		a_itr = atomics.find(assumptions[i].first);
+		if(a_itr == atomics.end()) { continue; } // Atomic not in any premise.
+		a_itr->second->setValue(assumptions[i].second);
+		std::list<FullStatement>::iterator itr;
+		bool erase;
+		for(itr = full_statements.begin(); itr != full_statements.end(); erase ? itr : ++itr) {
+			erase = false;
+			if(itr->containsAtomic(a_itr->second)) {
+				itr->evaluate(a_itr->second, write);
+				if(itr->getValSet() && !itr->getVal()) { open = false; }
+				else if(itr->getValSet() && itr->getVal()) {
+					itr = full_statements.erase(itr);
+					erase = true;
+				}
+			}
+		}
+	}
+	return open;
+}
+
+/* Gathers clauses of current premises with assumptions applied, and their atomics other
+   than assumed ones. Returns false if an assumption leaves an empty clause, contradicting
+   assumptions leave only an empty clause. Also returns false if limits are reached while
+   converting, then clauses are not usable. */
+bool Solver::loadClauses(const std::vector<Literal>& assumptions, std::list<Clause>& cls,
+						 std::map<std::string, Atomic*>& atoms, SearchLimits& limits) {
+	/* Premises added since last CNF solve are converted once, parsed trees kept intact. Each
+	   is converted into its own list on worker threads, lists kept in premise order. */
+	for(uint i=0; i < cut_short.size(); ++i) { delete cut_short[i]; }
+	cut_short.clear();
+	std::vector<const FullStatement*> todo;
+	std::list<FullStatement>::const_iterator s_itr = premises.begin();
+	for(std::advance(s_itr, premise_clauses.size()); s_itr != premises.end(); ++s_itr) { todo.push_back(&*s_itr); }
+	uint first = premise_clauses.size();
+	std::vector<std::list<Clause> > converted(todo.size());
+	std::vector<std::exception_ptr> errors(todo.size());
+	std::vector<FullStatement*> copies(todo.size(), NULL);
+	parallelFor(todo.size(), jobs, [&](uint k) {
+		uint i = first+k;
+		if(sources[i] != int(i)) { return; } // No clauses needed.
+		if(todo[k]->getValSet()) { // Always false, one empty clause.
+			converted[k].push_back(Clause());
+			return;
+		}
+		try {
+			copies[k] = new FullStatement(*todo[k]);
+			if(ClauseSet::extract(*copies[k], converted[k], false, &limits)) {
+				delete copies[k];
+				copies[k] = NULL;
+			}
+		} catch(...) { errors[k] = std::current_exception(); }
+	});
+	// Freeing a large partly converted copy takes long, left to next conversion or destructor.
+	for(uint k=0; k < copies.size(); ++k) {
+		if(copies[k]) { cut_short.push_back(copies[k]); }
+	}
+	rethrowFirst(errors);
+	// Conversions cut short are dropped, done again by next solve.
+	if(limits.reached()) { return false; }
+	for(uint k=0; k < converted.size(); ++k) {
+		premise_clauses.push_back(std::list<Clause>());
+		premise_clauses.back().swap(converted[k]);
+	}
+	// Only literals of current premises take part in solving.
+	cls.clear();
+	atoms.clear();
+	std::list<std::list<Clause> >::const_iterator p_itr;
+	for(p_itr = premise_clauses.begin(); p_itr != premise_clauses.end(); ++p_itr) {
+		for(std::list<Clause>::const_iterator c_itr = p_itr->begin(); c_itr != p_itr->end(); ++c_itr) {
+			cls.push_back(*c_itr);
+			for(Clause::const_iterator l_itr = c_itr->begin(); l_itr != c_itr->end(); ++l_itr) {
+				atoms[l_itr->first.first] = l_itr->second;
+			}
+		}
+	}
+	if(conflicting(assumptions)) {
+		cls.assign(1, Clause());
+		for(uint i=0; i < assumptions.size(); ++i) { atoms.erase(assumptions[i].first); }
+		return false;
+	}
+	ClauseSet clause_set(cls, atoms);
+	for(uint i=0; i < assumptions.size(); ++i) {
+		clause_set.assign(assumptions[i]);
+		atoms.erase(assumptions[i].first);
+	}
+	cls = clause_set.getClauses();
+	std::pair<bool,bool> result = clause_set.emptyClause();
+	return !result.first || result.second;
+}
+
+// Fills map with every atomic of current premises that is not assumed.
+void Solver::universe(const std::vector<Literal>& assumptions, std::map<std::string, bool>& free) const {
+	free.clear();
+	for(uint i=0; i < premise_atoms.size(); ++i) {
+		for(uint j=0; j < premise_atoms[i].size(); ++j) { free[premise_atoms[i][j]] = false; }
+	}
+	for(uint i=0; i < assumptions.size(); ++i) { free.erase(assumptions[i].first); }
+}
+
+/* Solves current premises with assumption literals fixed beforehand. Assumptions only narrow
+   this solve, premises are left untouched. */
+Verdict Solver::solve(const SolveOptions& options, const std::vector<Literal>& assumptions) {
+	TraceScope trace("solve");
+	output_tree.clear();
+	record.clear();
+	jsonl_tree = options.tree_format == TREE_JSONL && !options.verdict_only;
+	model.clear();
+	SearchLimits limits(options, &cancelled);
+	SearchState state;
+	state.write = !options.verdict_only;
+	state.limits = &limits;
+	if(jsonl_tree) { state.record = &record; }
+	state.tree_nodes = options.tree_nodes;
+	state.tree_depth = options.tree_depth;
+	if(options.cnf) {
+		std::list<Clause> cls;
+		std::map<std::string,Atomic*> atoms;
+		if(loadClauses(assumptions, cls, atoms, limits) || !limits.reached()) {
+			ClauseSet clause_set(cls, atoms);
+			clause_set.getState() = state;
+			clause_set.evaluate({"",true}, 0);
+			output_tree = clause_set.getOutput();
+			state = clause_set.getState();
+		}
+	} else {
+		std::list<FullStatement> full_statements;
+		bool open = loadStatements(assumptions, state.write, full_statements);
+		// Load output string encoding with premises as entered as root.
+		std::list<FullStatement>::const_iterator c_itr;
+		if(state.write && state.record) {
+			state.parent = record_output(premises, "", state);
+			// Premises false before search close root, as a step leaving only '[False]'.
+			if(!open) { state.record->step(state.parent, "Simplify", {state.record->formula("[False]")}); }
+		} else if(state.write) {
+			output_tree.assign(1, "#");
+			for(c_itr = premises.begin(); c_itr != premises.end(); ++c_itr) {
+				output_tree[0] += " " + c_itr->getOrig();
+			}
+			if(open && full_statements.empty()) { output_tree[0] += " [True]"; }
+			else if(!open) { output_tree[0] += " [False]"; } // Closed without branching.
+		}
+		if(open && full_statements.empty()) { state.openBranch(0); }
+		else if(open) {
+			// Search over atomics of remaining statements that are not assumed.
+			std::map<std::string,Atomic*> search_atomics;
+			for(c_itr = full_statements.begin(); c_itr != full_statements.end(); ++c_itr) {
+				unsetAtomics(*c_itr, search_atomics);
+			}
+			recount(search_atomics, full_statements);
+			dpSolve(full_statements, search_atomics, output_tree, 1, state);
+		}
+	}
+	limit_reached = limits.reached();
+	search_nodes = state.nodes;
+	if(!state.solved) { return limit_reached ? UNKNOWN : INCONSISTENT; }
+	// Literals of open branch and assumptions form the model, others are free.
+	universe(std::vector<Literal>(), model);
+	for(uint i=0; i < assumptions.size(); ++i) { model[assumptions[i].first] = assumptions[i].second; }
+	const std::vector<Literal>& cube = state.cubes.front();
+	for(uint i=0; i < cube.size(); ++i) { model[cube[i].first] = cube[i].second; }
+	return CONSISTENT;
+}
+
+/* Lists satisfying assignments of atomics in current premises, at most max_models of them
+   if nonzero. Every open branch is expanded over the atomics it leaves free. */
+uint Solver::enumerate(const SolveOptions& options, const std::vector<Literal>& assumptions,
+					   uint max_models) {
+	TraceScope trace("enumerate");
+	output_tree.clear();
+	record.clear();
+	jsonl_tree = false;
+	models.clear();
+	SearchLimits limits(options, &cancelled);
+	limit_reached = false;
+	SearchState state;
+	state.limits = &limits;
+	state.write = false;
+	state.all = true;
+	state.keep_cubes = true;
+	state.max_cubes = max_models;
+	if(options.cnf) {
+		std::list<Clause> cls;
+		std::map<std::string,Atomic*> atoms;
+		if(!loadClauses(assumptions, cls, atoms, limits)) {
+			limit_reached = limits.reached();
+			return 0;
+		}
+		ClauseSet clause_set(cls, atoms);
+		clause_set.getState() = state;
+		clause_set.evaluate({"",true}, 0);
+		state = clause_set.getState();
+	} else {
+		std::list<FullStatement> full_statements;
+		if(!loadStatements(assumptions, false, full_statements)) { return 0; }
+		if(full_statements.empty()) { state.cubes.push_back(std::vector<Literal>()); }
+		else {
+			std::map<std::string,Atomic*> search_atomics;
+			std::list<FullStatement>::const_iterator c_itr;
+			for(c_itr = full_statements.begin(); c_itr != full_statements.end(); ++c_itr) {
+				unsetAtomics(*c_itr, search_atomics);
+			}
+			recount(search_atomics, full_statements);
+			dpSolve(full_statements, search_atomics, output_tree, 1, state);
+		}
+	}
+	limit_reached = limits.reached();
+	std::map<std::string, bool> fixed;
+	universe(std::vector<Literal>(), fixed);
+	for(uint i=0; i < assumptions.size(); ++i) {
+		if(fixed.find(assumptions[i].first) != fixed.end()) { fixed[assumptions[i].first] = assumptions[i].second; }
+	}
+	std::map<std::string, bool> free;
+	universe(assumptions, free);
+	for(uint i=0; i < state.cubes.size(); ++i) {
+		std::map<std::string, bool> assign(fixed);
+		std::vector<std::string> free_atoms;
+		for(uint j=0; j < state.cubes[i].size(); ++j) { assign[state.cubes[i][j].first] = state.cubes[i][j].second; }
+		std::map<std::string, bool>::const_iterator f_itr;
+		for(f_itr = free.begin(); f_itr != free.end(); ++f_itr) {
+			bool on_trail = false;
+			for(uint j=0; j < state.cubes[i].size() && !on_trail; ++j) {
+				on_trail = state.cubes[i][j].first == f_itr->first;
+			}
+			if(!on_trail) { free_atoms.push_back(f_itr->first); }
+		}
+		// Binary counter over free atomics lists every extension of the open branch.
+		std::vector<bool> bits(free_atoms.size(), false);
+		while(true) {
+			for(uint j=0; j < free_atoms.size(); ++j) { assign[free_atoms[j]] = bits[j]; }
+			models.push_back(assign);
+			if(max_models && models.size() >= max_models) { return models.size(); }
+			uint j = 0;
+			while(j < bits.size() && bits[j]) { bits[j++] = false; }
+			if(j == bits.size()) { break; }
+			bits[j] = true;
+		}
+	}
+	return models.size();
+}
+
+/* Counts satisfying assignments of atomics in current premises without listing them.
+   Premises sharing no atomics are counted separately and multiplied, atomics left in no
+   premise after assumptions double the count. */
+unsigned long long Solver::count(const SolveOptions& options, const std::vector<Literal>& assumptions) {
+	TraceScope trace("count");
+	output_tree.clear();
+	record.clear();
+	jsonl_tree = false;
+	SearchLimits limits(options, &cancelled);
+	limit_reached = false;
+	std::map<std::string, bool> free;
+	universe(assumptions, free);
+	std::vector<std::vector<std::string> > unit_atoms;
+	std::vector<uint> comp;
+	unsigned long long total = 1;
+	if(options.cnf) {
+		std::list<Clause> cls;
+		std::map<std::string,Atomic*> atoms;
+		if(!loadClauses(assumptions, cls, atoms, limits)) {
+			limit_reached = limits.reached();
+			return 0;
+		}
+		std::list<Clause>::const_iterator c_itr;
+		for(c_itr = cls.begin(); c_itr != cls.end(); ++c_itr) {
+			unit_atoms.push_back(std::vector<std::string>());
+			for(Clause::const_iterator l_itr = c_itr->begin(); l_itr != c_itr->end(); ++l_itr) {
+				unit_atoms.back().push_back(l_itr->first.first);
+				free.erase(l_itr->first.first);
+			}
+		}
+		comp = components(unit_atoms);
+		uint n_comp = comp.empty() ? 0 : *std::max_element(comp.begin(), comp.end()) + 1;
+		for(uint c=0; c < n_comp && total; ++c) {
+			std::list<Clause> comp_cls;
+			std::map<std::string,Atomic*> comp_atoms;
+			uint i = 0;
+			for(c_itr = cls.begin(); c_itr != cls.end(); ++c_itr, ++i) {
+				if(comp[i] != c) { continue; }
+				comp_cls.push_back(*c_itr);
+				for(uint j=0; j < unit_atoms[i].size(); ++j) { comp_atoms[unit_atoms[i][j]] = atoms[unit_atoms[i][j]]; }
+			}
+			ClauseSet clause_set(comp_cls, comp_atoms);
+			clause_set.getState().write = false;
+			clause_set.getState().all = true;
+			clause_set.getState().limits = &limits;
+			clause_set.evaluate({"",true}, 0);
+			unsigned long long comp_count = clause_set.getState().count;
+			if(comp_count && total > ~0ULL / comp_count) { throw DPError("Model count exceeds 64 bits."); }
+			total *= comp_count;
+		}
+	} else {
+		std::list<FullStatement> full_statements;
+		if(!loadStatements(assumptions, false, full_statements)) { return 0; }
+		std::list<FullStatement>::iterator s_itr;
+		std::vector<std::map<std::string,Atomic*> > statement_atoms(full_statements.size());
+		uint i = 0;
+		for(s_itr = full_statements.begin(); s_itr != full_statements.end(); ++s_itr, ++i) {
+			unsetAtomics(*s_itr, statement_atoms[i]);
+			unit_atoms.push_back(std::vector<std::string>());
+			std::map<std::string,Atomic*>::const_iterator a_itr;
+			for(a_itr = statement_atoms[i].begin(); a_itr != statement_atoms[i].end(); ++a_itr) {
+				unit_atoms.back().push_back(a_itr->first);
+				free.erase(a_itr->first);
+			}
+		}
+		comp = components(unit_atoms);
+		uint n_comp = comp.empty() ? 0 : *std::max_element(comp.begin(), comp.end()) + 1;
+		// Move statements of each component into their own list, no copies needed.
+		std::vector<std::list<FullStatement> > comp_statements(n_comp);
+		std::vector<std::map<std::string,Atomic*> > comp_atoms(n_comp);
+		i = 0;
+		for(s_itr = full_statements.begin(); s_itr != full_statements.end(); ++i) {
+			comp_atoms[comp[i]].insert(statement_atoms[i].begin(), statement_atoms[i].end());
+			comp_statements[comp[i]].splice(comp_statements[comp[i]].end(), full_statements, s_itr++);
+		}
+		for(uint c=0; c < n_comp && total; ++c) {
+			SearchState state;
+			state.write = false;
+			state.all = true;
+			state.limits = &limits;
+			recount(comp_atoms[c], comp_statements[c]);
+			dpSolve(comp_statements[c], comp_atoms[c], output_tree, 1, state);
+			if(state.count && total > ~0ULL / state.count) { throw DPError("Model count exceeds 64 bits."); }
+			total *= state.count;
+		}
+	}
+	limit_reached = limits.reached();
+	if(limit_reached) { return 0; } // Partial counts are not reported.
+	if(total) {
+		unsigned long long free_count = 0;
+		addPower(free_count, free.size());
+		if(total > ~0ULL / free_count) { throw DPError("Model count exceeds 64 bits."); }
+		total *= free_count;
+	}
+	return total;
+}
+
+// Premises as parsed, in order entered, separated by ';'.
+std::string Solver::premiseText() const {
+	std::string text;
+	std::list<FullStatement>::const_iterator p_itr;
+	for(p_itr = premises.begin(); p_itr != premises.end(); ++p_itr) { text += p_itr->getOrig() + ";"; }
+	return text;
+}
+
+/* Writes canonical text of premise with atomics replaced by their number (by '?' if masked),
+   numbering atomics not seen before in order of appearance. */
+static std::string renameAtomics(const std::string& key, std::map<std::string, uint>& ids,
+								 std::vector<std::string>& names, bool mask) {
+	if(key == "[False]") { return key; }
+	std::string text;
+	for(uint i=0; i < key.size(); ) {
+		if(!(char_class[(unsigned char)key[i]] & CH_LETTER)) {
+			text += key[i++];
+			continue;
+		}
+		uint j = i;
+		while(j < key.size() && (char_class[(unsigned char)key[j]] & CH_LETTER)) { ++j; }
+		std::string atom = key.substr(i, j-i);
+		i = j;
+		if(mask) {
+			text += '?';
+			continue;
+		}
+		if(ids.insert({atom, names.size()}).second) { names.push_back(atom); }
+		text += '#' + std::to_string(ids[atom]);
+	}
+	return text;
+}
+
+/* Text of premises as solved, the same for premise sets differing only in premise order,
+   repeated or always true premises, operand order, and (in most cases) consistent renaming of
+   atomics: premises are sorted and atomics numbered by first appearance. Fills atomic names by
+   number. Equal texts always mean premise sets equal up to renaming. */
+std::string Solver::canonicalText(std::vector<std::string>& names) const {
+	std::vector<std::pair<std::string, std::string> > keys; // Text with atomics masked, and key.
+	std::unordered_map<std::string, uint>::const_iterator k_itr;
+	std::map<std::string, uint> ids;
+	for(k_itr = canonical.begin(); k_itr != canonical.end(); ++k_itr) {
+		keys.push_back({renameAtomics(k_itr->first, ids, names, true), k_itr->first});
+	}
+	// Numbering from order of shapes, then again from order of numbered premises.
+	std::sort(keys.begin(), keys.end());
+	for(uint round=0; round < 2; ++round) {
+		ids.clear();
+		names.clear();
+		for(uint i=0; i < keys.size(); ++i) { keys[i].first = renameAtomics(keys[i].second, ids, names, false); }
+		std::sort(keys.begin(), keys.end());
+	}
+	std::string text;
+	for(uint i=0; i < keys.size(); ++i) { text += keys[i].first + ";"; }
+	return text;
+}
+
+// Checks premise text for invalid characters and malformed parentheses.
+void Solver::checkStatement(std::string& stat) {
+	if(stat.empty()) { throw DPError("Blank statement entered."); }
+	// Accepts operator shortcuts, letters, and parentheses, classes found in lookup table.
+	const uint valid = CH_LETTER | CH_OPERATOR | CH_NEGATE | CH_OPEN | CH_CLOSE;
+	int left_par=0;
+	int right_par=0;
+	for(uint i=0; i<stat.size(); ++i) {
+		if(stat[i] == '~') { stat[i] = '!'; } // Allows either negation shortcut.
+		unsigned char cls = char_class[(unsigned char)stat[i]];
+		// Check that all input uses valid characters.
+		if(!(cls & valid)) {
+			throw DPError("Invalid characters in " + stat);
+		}
+		// No atomics or closing parenthesis preceding opening parentheis.
+		if(cls & CH_OPEN) {
+			if(i>0 && !(char_class[(unsigned char)stat[i-1]] & (CH_OPERATOR | CH_OPEN | CH_NEGATE))) {
+				throw DPError("Improper logic expression: " + stat);
+			}
+			++left_par; }
+		// No atomics or opening parenthesis following closing parentheis.
+		if(cls & CH_CLOSE) {
+			if(i+1 < stat.size() && !(char_class[(unsigned char)stat[i+1]] & (CH_OPERATOR | CH_CLOSE))) {
+				throw DPError("Improper logic expression: " + stat);
+			} // Number of closing parentheses can never exceed opening parentheses.
+			if(left_par <= right_par) {
+				throw DPError("Mismatched parentheses in " + stat);
+			}
+			++right_par;
+		}
+	}
+	if(left_par != right_par) {
+		throw DPError("Mismatched parentheses in " + stat);
+	}
+}
+
+// Converting heap vector into output string encoding solved tree graphic.
+std::string Solver::formatTree(const std::vector<std::string>& output_tree) {
+	if(output_tree.empty()) { return "end"; } // Tree not written in verdict only mode.
+	std::string output(output_tree[0]);
+	uint branch_index = 1;
+	int node;
+	for(uint i=1; i < output_tree.size(); ++i) {
+		// Create alternating lines of node statements and branches marked with literals.
+		if(i == branch_index) {
+			output += "\n";
+			branch_index = (branch_index+1)*2 - 1;
+			for(uint j=i; j < branch_index && j < output_tree.size(); ++j) {
+				// Case of blank branches/nodes.
+				if(output_tree[j] == "# ") { output += "- "; }
+				else {
+					node = output_tree[j].find('#');
+					// Prints literal on branch line.
+					output += output_tree[j].substr(0, node);
+				}
+			}
+			output += "\n";
+		}
+		node = output_tree[i].find('#');
+		output += output_tree[i].substr(node); // Prints statements on node line.
+		if(output_tree[i] != "# ") { output += " "; }
+	}
+	output += "\nend"; // Terminating tag.
+	return output;
+}
\ No newline at end of file
@@ -1,13 +1,16 @@
-#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <deque>
 #include <string>
+#include <vector>
 #include <map>
+#include <set>
 #include "davis_putnam.h"
 
 // Access set truth value of atomic.
 bool Atomic::getValue() const {
 	if(!set_val) {
-		std::cerr << "Error: No set truth value of " << name << std::endl;
-		exit(1);
+		throw DPError("No set truth value of " + name);
 	}
 	return val;
 }
@@ -18,128 +21,190 @@ void Atomic::setValue(bool v) {
 	set_val = true;
 }
 
-// Constructor for Statement objects. Also fills maps for atomic objects.
-Statement::Statement(const std::string& raw_stat, std::map<std::string,Atomic*>& atomics, std::string& orig) {
-	std::string raw = raw_stat;
-	redundancy(raw); // Remove excess parentheses.
-	if(raw.back() == '!') { // Negation operator cannot be last character.
-		std::cerr << "Error: Improper placement of negate operator in " << raw << std::endl;
-		exit(1);
-	}
-	// Locate outer parenthesis set to determine central operator.
-	uint i = raw.rfind(')');
-	if(i < raw.size() && i == raw.size()-1){
-		--i;
-		int open_par = 1;
-		while(open_par) {
-			if(raw[i] == ')') { ++open_par; }
-			else if(raw[i] == '(') { --open_par; }
-			--i;
-		}
-	} else { i = raw.size()-1; }
-	uint op_pos = raw.find_last_of("&|$%", i);
-	if(op_pos > raw.size()) {
-		uint parenth1 = raw.find('(');
-		// Case in which outer parenthesis set is negated.
-		if(parenth1 < raw.size() && raw.substr(0, parenth1) == std::string(parenth1, '!')) {
-			raw = raw.substr(parenth1);
-			std::string orig2;
-			// Recurse to read-in statement within parentheses, copy info back to this node.
-			Statement temp = Statement(raw, atomics, orig2);
-			reassign(temp);
-			negated = bool(parenth1 % 2);
-			if(temp.negated) { negated = !negated; } // In case of nested negations.
-			if(op_sym != ' ') { orig2 = '(' + orig2 + ')'; }
-			orig = std::string(parenth1, '!') + orig2;
-			return;
-		}
-		// Case of reaching literal.
-		uint last_n = raw.find_first_not_of('!');
-		negated = bool(last_n % 2);
-		raw = raw.substr(last_n);
-		if(raw.find('!') < raw.size()) {
-			std::cerr << "Error: Improper placement of negate operator in " << raw << std::endl;
-			exit(1);
-		}
-		// Create atomic object if first time encountered, add to map.
-		std::map<std::string,Atomic*>::iterator itr = atomics.find(raw);
-		if(itr == atomics.end()) {
-			Atomic* new_atomic = new Atomic(raw);
-			atomics.insert(std::make_pair(raw, new_atomic));
-		}
-		++(*atomics[raw]);
-		s_atomics[raw] = atomics[raw];
-		// Rewrite atomic statement with same number of negations (not preserved in solvers.)
-		orig = std::string(last_n, '!') + raw;
+// Adds atomic id to set, growing words past the inline one as needed.
+void AtomSet::insert(uint id) {
+	if(id < 64) {
+		low |= uint64_t(1) << id;
 		return;
 	}
-	// No binary operators as first/last character or adjacent to other operators and parentheses.
-	if(op_pos==0 || op_pos==raw.size()-1 || raw[op_pos-1]=='(' || raw[op_pos+1]==')' || 
-	  raw.find_first_of("&|$%", op_pos+1)==op_pos+1 || raw[op_pos-1]=='!') {
-		std::cerr << "Error: Improper placement of operator in " << raw << std::endl;
-		exit(1);
-	}
-	op_sym = raw[op_pos];
-	std::string l_orig;
-	std::string r_orig;
-	// Recurse to make new statement from left and right sides of central operator.
-	left_ = new Statement(raw.substr(0, op_pos), atomics, l_orig);
-	left_->parent_ = this;
-	right_ = new Statement(raw.substr(op_pos+1), atomics, r_orig);
-	right_->parent_ = this;
-	// Make atomics map containing union of left and right child nodes.
-	s_atomics = left_->s_atomics;
-	mergeAtomics(right_->s_atomics);
-	// Rewrite text statement, adding parentheses to children if needed.
-	if(left_->op_sym != ' ' && !left_->negated) {
-		l_orig = '(' + l_orig + ')';
-	}
-	if(right_->op_sym != ' ' && !right_->negated) {
-		r_orig = '(' + r_orig + ')';
-	}
-	orig = l_orig + op_sym + r_orig;
+	if(id/64 > high.size()) { high.resize(id/64, 0); }
+	high[id/64-1] |= uint64_t(1) << id%64;
 }
 
-// Returns if Statement includes atomic.
-bool Statement::containsAtomic(const std::string& a) const {
-	if(s_atomics.find(a) != s_atomics.end()) { return true; }
-	return false;
+// Removes atomic id from set.
+void AtomSet::erase(uint id) {
+	if(id < 64) { low &= ~(uint64_t(1) << id); }
+	else if(id/64-1 < high.size()) { high[id/64-1] &= ~(uint64_t(1) << id%64); }
 }
 
-// Copy constructor helper function.
-Statement* Statement::copy() const {
-	Statement* copy_s = new Statement;
-	copy_s->op_sym = op_sym;
-	copy_s->negated = negated;
-	copy_s->val = val;
-	copy_s->set_val = set_val;
-	copy_s->s_atomics = s_atomics;
-	if(left_) {
-		copy_s->left_ = left_->copy();
-		copy_s->left_->parent_ = copy_s;
-		copy_s->right_ = right_->copy();
-		copy_s->right_->parent_ = copy_s;
-	} else {
-		copy_s->left_ = NULL;
-		copy_s->right_ = NULL;
+// Union with other set, one word at a time.
+void AtomSet::merge(const AtomSet& s2) {
+	low |= s2.low;
+	if(s2.high.size() > high.size()) { high.resize(s2.high.size(), 0); }
+	for(uint i=0; i < s2.high.size(); ++i) { high[i] |= s2.high[i]; }
+}
+
+/* Constructor for Statement objects, parses text into tree below this node. Also fills maps
+   for atomic objects. Uses explicit stack over ranges of text, so nesting depth is bounded only
+   by memory. */
+Statement::Statement(const std::string& raw, std::map<std::string,Atomic*>& atomics, std::string& orig) {
+	// Matching parenthesis of each parenthesis, so outer sets are found without scanning.
+	std::vector<uint> match(raw.size(), raw.size());
+	std::vector<uint> open;
+	for(uint i=0; i < raw.size(); ++i) {
+		if(raw[i] == '(') { open.push_back(i); }
+		else if(raw[i] == ')' && !open.empty()) {
+			match[i] = open.back();
+			match[open.back()] = i;
+			open.pop_back();
+		}
+	}
+	// Node to read from text range, or text to write if node is NULL.
+	struct Part {
+		Statement* s;
+		uint begin, end;
+		std::string text;
+	};
+	std::vector<Part> stack(1, {this, 0, uint(raw.size()), ""});
+	try {
+		while(!stack.empty()) {
+			Part part = std::move(stack.back());
+			stack.pop_back();
+			if(!part.s) {
+				orig += part.text;
+				continue;
+			}
+			Statement* s = part.s;
+			uint b = part.begin, e = part.end;
+			std::vector<uint> groups; // Negations of each negated parenthesis set, outermost first.
+			uint op_pos = raw.size();
+			while(true) {
+				while(b < e && raw[b] == '(' && match[b] == e-1) { // Remove excess parentheses.
+					++b;
+					--e;
+				}
+				if(b == e) { throw DPError("Improper logic expression: " + raw); } // Empty parentheses.
+				if(raw[e-1] == ')' && match[e-1] == raw.size()) {
+					throw DPError("Mismatched parentheses in " + raw);
+				}
+				if(raw[e-1] == '!') { // Negation operator cannot be last character.
+					throw DPError("Improper placement of negate operator in " + raw.substr(b, e-b));
+				}
+				// Central operator is last one before outer parenthesis set ending the text, if any.
+				uint i = raw[e-1] == ')' ? match[e-1] : e;
+				while(i > b && !strchr("&|$%", raw[i-1])) { --i; }
+				if(i > b) {
+					op_pos = i-1;
+					break;
+				}
+				uint parenth1 = raw.find_first_not_of('!', b);
+				// Case in which outer parenthesis set is negated, read on within it.
+				if(parenth1 >= e || parenth1 == b || raw[parenth1] != '(') { break; }
+				groups.push_back(parenth1-b);
+				b = parenth1;
+			}
+			uint negations = 0;
+			for(uint i=0; i < groups.size(); ++i) { negations += groups[i]; }
+			if(op_pos == raw.size()) { // Case of reaching literal.
+				uint last_n = raw.find_first_not_of('!', b)-b;
+				s->negated = bool((negations+last_n) % 2);
+				std::string name = raw.substr(b+last_n, e-b-last_n);
+				if(name.find('!') < name.size()) {
+					throw DPError("Improper placement of negate operator in " + name);
+				}
+				// Create atomic object if first time encountered, add to map. Map is only read if
+				// atomics were added beforehand, so premises can be parsed concurrently.
+				std::map<std::string,Atomic*>::iterator itr = atomics.find(name);
+				if(itr == atomics.end()) {
+					itr = atomics.insert(std::make_pair(name, new Atomic(name, atomics.size()))).first;
+				}
+				s->atom_ = itr->second;
+				s->s_atomics.insert(s->atom_->getId());
+				// Rewrite atomic statement with same number of negations (not preserved in solvers.)
+				orig += std::string(negations+last_n, '!') + name;
+				continue;
+			}
+			// No binary operators as first/last character or adjacent to other operators and parentheses.
+			if(op_pos==b || op_pos==e-1 || raw[op_pos-1]=='(' || raw[op_pos+1]==')' ||
+			  strchr("&|$%", raw[op_pos+1]) || raw[op_pos-1]=='!') {
+				throw DPError("Improper placement of operator in " + raw.substr(b, e-b));
+			}
+			s->op_sym = raw[op_pos];
+			s->negated = bool(negations % 2);
+			// Rewrite text statement, adding parentheses to children if needed.
+			bool wrap = s != this && !s->negated;
+			std::string prefix(wrap ? "(" : ""), suffix;
+			for(uint i=0; i < groups.size(); ++i) {
+				prefix += std::string(groups[i], '!') + '(';
+				suffix += ')';
+			}
+			if(wrap) { suffix += ')'; }
+			orig += prefix;
+			// Read left and right sides of central operator, left first.
+			s->left_ = new Statement;
+			s->left_->parent_ = s;
+			s->right_ = new Statement;
+			s->right_->parent_ = s;
+			stack.push_back({NULL, 0, 0, suffix});
+			stack.push_back({s->right_, op_pos+1, e, ""});
+			stack.push_back({NULL, 0, 0, std::string(1, s->op_sym)});
+			stack.push_back({s->left_, b, op_pos, ""});
+		}
+	} catch(...) { // Constructor not completed, no destructor will free nodes below.
+		if(left_) { left_->destroy(); }
+		if(right_) { right_->destroy(); }
+		throw;
 	}
-	return copy_s;
+	// Make atomics sets containing union of child nodes.
+	resetAtomics();
 }
 
-// Destructor helper function.
-void Statement::destroy() {
-	if(left_) { left_->destroy(); }
-	if(right_) { right_->destroy(); }
-	delete this;
+// Copy constructor helper function, copies nodes top-down with explicit stack.
+Statement* Statement::copy(LeafIndex* leaves) const {
+	Statement* top = new Statement;
+	std::vector<std::pair<const Statement*, Statement*> > stack(1, std::make_pair(this, top));
+	while(!stack.empty()) {
+		const Statement* s = stack.back().first;
+		Statement* copy_s = stack.back().second;
+		stack.pop_back();
+		copy_s->op_sym = s->op_sym;
+		copy_s->negated = s->negated;
+		copy_s->val = s->val;
+		copy_s->set_val = s->set_val;
+		copy_s->s_atomics = s->s_atomics;
+		copy_s->atom_ = s->atom_;
+		if(s->left_) {
+			copy_s->left_ = new Statement;
+			copy_s->left_->parent_ = copy_s;
+			copy_s->right_ = new Statement;
+			copy_s->right_->parent_ = copy_s;
+			stack.push_back(std::make_pair(s->right_, copy_s->right_));
+			stack.push_back(std::make_pair(s->left_, copy_s->left_));
+		} else if(leaves) { (*leaves)[s->atom_->getId()].push_back(copy_s); }
+	}
+	return top;
 }
 
-// Creates union of atomic elements from two maps.
-void Statement::mergeAtomics(const std::map<std::string, Atomic*>& atoms2) {
-	std::map<std::string, Atomic*>::const_iterator c_itr;
-	for(c_itr = atoms2.begin(); c_itr != atoms2.end(); ++c_itr) {
-		if(s_atomics.find(c_itr->first) == s_atomics.end()) {
-			s_atomics[c_itr->first] = c_itr->second;
+// Destructor helper function, frees this node and all nodes beneath.
+void Statement::destroy(LeafIndex* leaves) {
+	std::vector<Statement*> stack(1, this);
+	while(!stack.empty()) {
+		Statement* s = stack.back();
+		stack.pop_back();
+		if(s->right_) { stack.push_back(s->right_); }
+		if(s->left_) { stack.push_back(s->left_); }
+		if(leaves && s->op_sym == ' ') { // Unregister leaf, order of index does not matter.
+			LeafIndex::iterator l_itr = leaves->find(s->atom_->getId());
+			if(l_itr != leaves->end()) {
+				std::vector<Statement*>& nodes = l_itr->second;
+				std::vector<Statement*>::iterator n_itr = std::find(nodes.begin(), nodes.end(), s);
+				if(n_itr != nodes.end()) {
+					*n_itr = nodes.back();
+					nodes.pop_back();
+				}
+			}
 		}
+		delete s;
 	}
 }
 
@@ -149,7 +214,7 @@ void Statement::mergeAtomics(const std::map<std::string, Atomic*>& atoms2) {
    negated = true -> val = false -> true -> val = negated
    negated = false -> val = true -> val = !negated
    negated = false -> val = false -> val = negated */
-Statement* Statement::evaluate() {
+Statement* Statement::evaluate(LeafIndex* leaves) {
 	Statement* curr_s = this; // Fixes edge case where FullStatement root is simplified.
 	if(left_->set_val && !right_->set_val) {
 		if(op_sym == '&' && !left_->val) {
@@ -164,7 +229,7 @@ Statement* Statement::evaluate() {
 		} else {
 			if(parent_) { curr_s = right_; }
 			if(op_sym == '%' && !left_->val) { right_->negated = !right_->negated; }
-			simplify(right_);
+			simplify(right_, leaves);
 		}
 	} else if(!left_->set_val && right_->set_val) {
 		if(op_sym == '&' && !right_->val) {
@@ -179,7 +244,7 @@ Statement* Statement::evaluate() {
 			if(op_sym == '$' || (op_sym == '%' && !right_->val)) {
 				left_->negated = !left_->negated;
 			}
-			simplify(left_);
+			simplify(left_, leaves);
 		}
 	} else if(left_->set_val && right_->set_val) {
 		if(op_sym == '&') {
@@ -199,8 +264,7 @@ Statement* Statement::evaluate() {
 			if(negated) { val = !val; }
 			set_val = true;
 		} else {
-			std::cerr << "Error: Cannot evaluate undefined logical operator." << std::endl;
-			exit(1);
+			throw DPError("Cannot evaluate undefined logical operator.");
 		}
 	} else { set_val=false; }
 	return curr_s;
@@ -214,19 +278,24 @@ void Statement::reassign(Statement& s2) {
 	s2.left_ = NULL;
 	s2.right_ = NULL;
 	s_atomics = s2.s_atomics;
+	atom_ = s2.atom_;
 	if(left_) { left_->parent_ = this; }
 	if(right_) { right_->parent_ = this; }
 }
 
 // After setting one child's value, parent node replaced by child without set value if appropriate.
-void Statement::simplify(Statement* keep) {
+void Statement::simplify(Statement* keep, LeafIndex* leaves) {
 	if(!parent_) { // If parent is root, child's info is copied over.
-		if(keep == left_) { right_->destroy(); }
-		else { left_->destroy(); }
+		if(keep == left_) { right_->destroy(leaves); }
+		else { left_->destroy(leaves); }
 		reassign(*keep);
 		if(negated && keep->negated) { negated = false; }
 		else if(negated || keep->negated) { negated = true; }
 		else { negated = false; }
+		if(leaves && op_sym == ' ') { // Root now stands for leaf.
+			std::vector<Statement*>& nodes = (*leaves)[atom_->getId()];
+			std::replace(nodes.begin(), nodes.end(), keep, this);
+		}
 		delete keep;
 		return;
 	}
@@ -239,7 +308,7 @@ void Statement::simplify(Statement* keep) {
 	if(negated && keep->negated) { keep->negated = false; }
 	else if(negated || keep->negated) { keep->negated = true; }
 	else { keep->negated = false; }
-	destroy();
+	destroy(leaves);
 }
 
 // Replace conditional with 'or' operator, negate antecedent.
@@ -312,11 +381,274 @@ void Statement::DistribDisjunct(bool nested_left) {
 	op_sym = '&';
 	left_ = nested;
 	right_ = new_right;
-	// Fix atomics maps for nodes now in CNF.
+	// Fix atomics sets for nodes now in CNF.
 	left_->s_atomics = left_->left_->s_atomics;
-	left_->mergeAtomics(left_->right_->s_atomics);
+	left_->s_atomics.merge(left_->right_->s_atomics);
 	right_->s_atomics = right_->left_->s_atomics;
-	right_->mergeAtomics(right_->right_->s_atomics);
+	right_->s_atomics.merge(right_->right_->s_atomics);
+}
+
+/* Canonical text of subformula under construction. Text can grow at either end, so an operator
+   takes over the text of its largest operand and adds only the others. */
+struct KeyText {
+	std::string buf;
+	size_t begin = 0; // Free room before text.
+
+	KeyText() {}
+	explicit KeyText(const std::string& text) : buf(text) {}
+	std::string_view view() const { return std::string_view(buf).substr(begin); }
+	size_t size() const { return buf.size()-begin; }
+	void append(std::string_view text) { buf += text; }
+	void prepend(std::string_view text) {
+		if(text.size() > begin) { // Room doubles like the end of a string does.
+			size_t room = text.size() + buf.size();
+			buf.insert(0, room, ' ');
+			begin += room;
+		}
+		begin -= text.size();
+		buf.replace(begin, text.size(), text);
+	}
+	void negate() {
+		if(buf[begin] == '!') { ++begin; }
+		else { prepend("!"); }
+	}
+};
+
+// True if canonical text a is negation of b.
+static bool negationOf(std::string_view a, std::string_view b) {
+	if(b[0] == '!') { return a == b.substr(1); }
+	return a.size() == b.size()+1 && a[0] == '!' && a.substr(1) == b;
+}
+
+// Canonical text "(k1 op k2 op ...)" of operand keys in given order, largest key is reused.
+static KeyText joinKeys(const std::vector<KeyText*>& keys, char op) {
+	uint largest = 0;
+	for(uint i=1; i < keys.size(); ++i) {
+		if(keys[i]->size() > keys[largest]->size()) { largest = i; }
+	}
+	std::string before("("), after;
+	for(uint i=0; i < largest; ++i) { (before += keys[i]->view()) += op; }
+	for(uint i=largest+1; i < keys.size(); ++i) { (after += op) += keys[i]->view(); }
+	KeyText key = std::move(*keys[largest]);
+	key.prepend(before);
+	key.append(after);
+	key.append(")");
+	return key;
+}
+
+/* Operator node being simplified by Statement::normalize(), with its operands: both children, or
+   all operands of chain of nested 'and'/'or' operators, handled as one. */
+struct NormalFrame {
+	Statement* s;
+	std::vector<Statement*> inner, operands; // Nodes of chain, and operands in order.
+	uint next = 0; // Operand to simplify next.
+	Statement* parent_ = NULL; // Where operand being simplified is attached.
+	bool left = false;
+	std::vector<int> values;
+	std::vector<KeyText> keys;
+	std::vector<Statement*> keep, drop; // Operands of chain kept, and constant or repeated ones.
+	std::set<std::string_view> seen; // Keys of operands kept.
+	int value = -1; // Results as in Statement::normalize().
+	KeyText key;
+
+	explicit NormalFrame(Statement* s);
+	bool chain() const { return s->op_sym == '&' || s->op_sym == '|'; }
+	void add(Statement* o, int o_val, KeyText& o_key);
+	Statement* finish();
+	Statement* finishChain();
+};
+
+NormalFrame::NormalFrame(Statement* s) : s(s) {
+	if(!chain()) {
+		operands = {s->left_, s->right_};
+		return;
+	}
+	inner.push_back(s);
+	std::vector<Statement*> stack;
+	stack.push_back(s->right_);
+	stack.push_back(s->left_);
+	while(!stack.empty()) {
+		Statement* o = stack.back();
+		stack.pop_back();
+		if(o->op_sym == s->op_sym && !o->negated) {
+			inner.push_back(o);
+			stack.push_back(o->right_);
+			stack.push_back(o->left_);
+		} else { operands.push_back(o); }
+	}
+	keys.reserve(operands.size()); // Seen keys point into these.
+}
+
+// Attaches simplified operand in place of original, chain stops at first operand deciding value.
+void NormalFrame::add(Statement* o, int o_val, KeyText& o_key) {
+	if(left) { parent_->left_ = o; }
+	else { parent_->right_ = o; }
+	o->parent_ = parent_;
+	if(!chain()) {
+		values.push_back(o_val);
+		keys.push_back(std::move(o_key));
+		return;
+	}
+	int absorb = s->op_sym == '|'; // Value of chain if any operand has it.
+	bool complement = false;
+	if(o_val < 0) { // Look up negation without copying key.
+		o_key.negate();
+		complement = seen.count(o_key.view());
+		o_key.negate();
+	}
+	if(o_val == absorb || complement) { value = absorb; }
+	else if(o_val >= 0 || seen.count(o_key.view())) { drop.push_back(o); } // Constant or repeated.
+	else {
+		keep.push_back(o);
+		keys.push_back(std::move(o_key));
+		seen.insert(keys.back().view());
+	}
+}
+
+// Simplifies node once operands are done, returns node now in its place.
+Statement* NormalFrame::finish() {
+	if(chain()) { return finishChain(); }
+	int l_val = values[0], r_val = values[1];
+	KeyText& l_key = keys[0];
+	KeyText& r_key = keys[1];
+	bool same = l_val < 0 && r_val < 0 && l_key.view() == r_key.view();
+	bool complement = l_val < 0 && r_val < 0 && negationOf(l_key.view(), r_key.view());
+	if(s->op_sym == '$') {
+		if(!l_val || r_val == 1 || same) { value = 1; }
+		else if(l_val == 1 || complement) { // A$!A is !A.
+			key = std::move(r_key);
+			if(s->negated) { key.negate(); }
+			return s->replaceBy(s->right_, false);
+		} else if(!r_val) {
+			key = std::move(l_key);
+			if(!s->negated) { key.negate(); }
+			return s->replaceBy(s->left_, true);
+		} else { key = joinKeys({&l_key, &r_key}, '$'); }
+	} else {
+		if(l_val >= 0 && r_val >= 0) { value = l_val == r_val; }
+		else if(l_val >= 0) {
+			key = std::move(r_key);
+			if(s->negated != !l_val) { key.negate(); }
+			return s->replaceBy(s->right_, !l_val);
+		} else if(r_val >= 0) {
+			key = std::move(l_key);
+			if(s->negated != !r_val) { key.negate(); }
+			return s->replaceBy(s->left_, !r_val);
+		} else if(same || complement) { value = same; }
+		else if(l_key.view() < r_key.view()) { key = joinKeys({&l_key, &r_key}, '%'); }
+		else { key = joinKeys({&r_key, &l_key}, '%'); }
+	}
+	if(value >= 0 && s->negated) { value = !value; }
+	else if(value < 0 && s->negated) { key.prepend("!"); }
+	return s;
+}
+
+// Helper function of finish() for 'and'/'or', chain is only rebuilt if operands are dropped.
+Statement* NormalFrame::finishChain() {
+	int absorb = s->op_sym == '|';
+	if(value < 0 && keep.empty()) { value = !absorb; }
+	if(value >= 0) {
+		if(s->negated) { value = !value; }
+		return s;
+	}
+	std::vector<KeyText*> sorted;
+	for(uint i=0; i < keys.size(); ++i) { sorted.push_back(&keys[i]); }
+	std::sort(sorted.begin(), sorted.end(), [](const KeyText* a, const KeyText* b) { return a->view() < b->view(); });
+	if(keep.size() == 1) {
+		key = std::move(keys[0]);
+		if(s->negated) { key.negate(); }
+	} else {
+		key = joinKeys(sorted, s->op_sym);
+		if(s->negated) { key.prepend("!"); }
+	}
+	if(drop.empty()) { return s; }
+	for(uint i=0; i < drop.size(); ++i) { drop[i]->destroy(); }
+	// Rebuild chain from remaining operands, left to right.
+	char op = s->op_sym;
+	bool neg = s->negated;
+	for(uint i=0; i < inner.size(); ++i) { delete inner[i]; } // Operands stay allocated.
+	Statement* top = keep[0];
+	for(uint i=1; i < keep.size(); ++i) {
+		Statement* chain_s = new Statement;
+		chain_s->op_sym = op;
+		chain_s->left_ = top;
+		chain_s->right_ = keep[i];
+		top->parent_ = chain_s;
+		keep[i]->parent_ = chain_s;
+		top = chain_s;
+	}
+	if(keep.size() == 1) { top->negated = top->negated != neg; }
+	else { top->negated = neg; }
+	return top;
+}
+
+/* Simplifies subformula bottom-up before solving: folds constant operands, drops repeated
+   operands and detects complementary ones. Returns node now in place of this one. value is set
+   to 1 or 0 if subformula is always true or false (then left as is for caller to drop), -1
+   otherwise. key is set to canonical text, same for operands given in any order. Operators
+   are kept on explicit stack until their operands are done. */
+Statement* Statement::normalize(int& value, std::string& key) {
+	value = -1;
+	if(op_sym == ' ') {
+		key = (negated ? "!" : "") + atom_->getName();
+		return this;
+	}
+	std::deque<NormalFrame> stack; // Frames stay in place, seen keys point into them.
+	stack.emplace_back(this);
+	while(true) {
+		NormalFrame& f = stack.back();
+		if(f.next < f.operands.size() && f.value < 0) {
+			Statement* o = f.operands[f.next++];
+			f.parent_ = o->parent_;
+			f.left = o->parent_->left_ == o;
+			if(o->op_sym != ' ') {
+				stack.emplace_back(o);
+				continue;
+			}
+			KeyText o_key((o->negated ? "!" : "") + o->atom_->getName());
+			f.add(o, -1, o_key);
+			continue;
+		}
+		Statement* s = f.finish();
+		int s_val = f.value;
+		KeyText s_key = std::move(f.key);
+		stack.pop_back();
+		if(stack.empty()) {
+			value = s_val;
+			key = s_key.view();
+			return s;
+		}
+		stack.back().add(s, s_val, s_key);
+	}
+}
+
+// Replaces this node with one child, negated once more if flip is set. Returns child.
+Statement* Statement::replaceBy(Statement* keep, bool flip) {
+	keep->negated = keep->negated != (negated != flip);
+	if(keep == left_) { left_ = NULL; }
+	else { right_ = NULL; }
+	keep->parent_ = parent_;
+	destroy();
+	return keep;
+}
+
+// Rebuilds atomics sets of nodes beneath after restructuring, children before parents.
+void Statement::resetAtomics() {
+	std::vector<std::pair<Statement*, bool> > stack(1, std::make_pair(this, false));
+	while(!stack.empty()) {
+		Statement* s = stack.back().first;
+		bool children_done = stack.back().second;
+		stack.pop_back();
+		if(s->op_sym == ' ') { continue; }
+		if(children_done) {
+			s->s_atomics = s->left_->s_atomics;
+			s->s_atomics.merge(s->right_->s_atomics);
+			continue;
+		}
+		stack.push_back(std::make_pair(s, true));
+		stack.push_back(std::make_pair(s->right_, false));
+		stack.push_back(std::make_pair(s->left_, false));
+	}
 }
 
 // Deletes excess outer parentheses from text statement.
@@ -0,0 +1,93 @@
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "davis_putnam.h"
+
+// Begin ('B') or end ('E') event, time in nanoseconds since start().
+struct TraceEvent {
+	const char* name;
+	char phase;
+	uint64_t time;
+	uint depth;
+	size_t size;
+	std::string lit;
+};
+
+// Events of one thread, kept after the thread ends until written.
+struct TraceBuffer {
+	uint tid;
+	std::vector<TraceEvent> events;
+};
+
+std::atomic<bool> Trace::on(false);
+static std::chrono::steady_clock::time_point trace_start;
+static std::mutex buffers_mutex; // Guards list of buffers, not their events.
+static std::vector<std::unique_ptr<TraceBuffer> > buffers;
+static thread_local TraceBuffer* local_buffer = NULL;
+
+// Buffer of calling thread, registered on its first event.
+static TraceBuffer& buffer() {
+	if(!local_buffer) {
+		std::lock_guard<std::mutex> lock(buffers_mutex);
+		buffers.push_back(std::unique_ptr<TraceBuffer>(new TraceBuffer));
+		buffers.back()->tid = buffers.size();
+		local_buffer = buffers.back().get();
+	}
+	return *local_buffer;
+}
+
+static uint64_t now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-trace_start).count();
+}
+
+// Starts recording events on every thread, times relative to now.
+void Trace::start() {
+	trace_start = std::chrono::steady_clock::now();
+	on = true;
+}
+
+void Trace::begin(const char* name, uint depth) {
+	buffer().events.push_back({name, 'B', now(), depth, 0, std::string()});
+}
+
+void Trace::end(const char* name, const std::string& lit, size_t size) {
+	buffer().events.push_back({name, 'E', now(), 0, size, lit});
+}
+
+/* Writes events of all threads as Chrome trace JSON, one event per line:
+   {"name":"node","ph":"B","ts":12.345,"pid":1,"tid":1,"args":{"depth":3}}
+   {"name":"node","ph":"E","ts":20.5,"pid":1,"tid":1,"args":{"lit":"!A,C","size":4}}
+   Times are in microseconds. Threads still solving should be finished first. */
+void Trace::write(const std::string& path) {
+	on = false;
+	std::ofstream out(path);
+	if(!out) { throw DPError("Cannot write trace " + path); }
+	std::lock_guard<std::mutex> lock(buffers_mutex);
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	bool first = true;
+	for(uint i=0; i < buffers.size(); ++i) {
+		const TraceBuffer& b = *buffers[i];
+		out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << b.tid
+			<< ",\"args\":{\"name\":\"solver " << b.tid << "\"}}";
+		first = false;
+		for(uint j=0; j < b.events.size(); ++j) {
+			const TraceEvent& e = b.events[j];
+			char ts[32];
+			snprintf(ts, sizeof(ts), "%.3f", e.time/1000.0);
+			out << ",\n{\"name\":\"" << e.name << "\",\"ph\":\"" << e.phase << "\",\"ts\":" << ts
+				<< ",\"pid\":1,\"tid\":" << b.tid << ",\"args\":{";
+			if(e.phase == 'B') { out << "\"depth\":" << e.depth; }
+			else {
+				out << "\"size\":" << e.size;
+				if(!e.lit.empty()) { out << ",\"lit\":\"" << e.lit << "\""; } // Literals need no escaping.
+			}
+			out << "}}";
+		}
+	}
+	out << "\n]}\n";
+	for(uint i=0; i < buffers.size(); ++i) { buffers[i]->events.clear(); }
+}
@@ -0,0 +1,115 @@
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "davis_putnam.h"
+
+// Empties formula table and nodes for a new solve.
+void TreeRecord::clear() {
+	table.clear();
+	texts.clear();
+	nodes.clear();
+	bytes = 0;
+}
+
+// Returns id of formula text, adding it to the table the first time it is seen.
+uint TreeRecord::formula(const std::string& text) {
+	std::unordered_map<std::string, uint>::iterator itr = table.find(text);
+	if(itr != table.end()) { return itr->second; }
+	uint id = texts.size();
+	itr = table.insert(std::make_pair(text, id)).first;
+	texts.push_back(&itr->first);
+	bytes += text.size() + 16;
+	return id;
+}
+
+// Adds node branching from parent on literal, holding formulas by id. Returns its id.
+uint TreeRecord::node(uint parent, const std::string& lit, const std::vector<uint>& formulas) {
+	nodes.push_back(Node());
+	nodes.back().parent = parent;
+	nodes.back().lit = lit;
+	nodes.back().formulas = formulas;
+	bytes += lit.size() + 4*formulas.size() + 24;
+	return nodes.size()-1;
+}
+
+// Adds simplification step applied at node, with formulas remaining after it.
+void TreeRecord::step(uint node, const std::string& rule, const std::vector<uint>& formulas) {
+	nodes[node].steps.push_back(std::make_pair(rule, formulas));
+	bytes += rule.size() + 4*formulas.size() + 8;
+}
+
+// Adds summary node standing in for a collapsed subtree. Returns its id.
+uint TreeRecord::summary(uint parent, const std::string& lit, bool open, uint n, uint depth) {
+	uint id = node(parent, lit, std::vector<uint>());
+	nodes[id].summary = true;
+	nodes[id].open = open;
+	nodes[id].summary_nodes = n;
+	nodes[id].summary_depth = depth;
+	return id;
+}
+
+// Writes formula ids as JSON array.
+static void writeIds(std::string& out, const std::vector<uint>& ids) {
+	out += '[';
+	for(uint i=0; i < ids.size(); ++i) {
+		if(i) { out += ','; }
+		out += std::to_string(ids[i]);
+	}
+	out += ']';
+}
+
+// Writes text as JSON string.
+static void writeText(std::string& out, const std::string& text) {
+	out += '"';
+	for(uint i=0; i < text.size(); ++i) {
+		if(text[i] == '"' || text[i] == '\\') { out += '\\'; }
+		out += text[i];
+	}
+	out += '"';
+}
+
+/* JSON lines encoding: formula table first, then nodes in the order they were made, so
+   parents always come before children.
+   {"f":0,"text":"A|B"}
+   {"n":1,"p":0,"lit":"!A","f":[0,2],"steps":[["SubElim",[2]]]}
+   {"n":5,"p":1,"lit":"B","summary":{"open":false,"nodes":37,"depth":5}}
+   Root has "p":-1 and empty "lit". A node with no formulas is an open branch. */
+std::string TreeRecord::str() const {
+	std::string out;
+	out.reserve(bytes);
+	for(uint i=0; i < texts.size(); ++i) {
+		out += "{\"f\":" + std::to_string(i) + ",\"text\":";
+		writeText(out, *texts[i]);
+		out += "}\n";
+	}
+	for(uint i=0; i < nodes.size(); ++i) {
+		const Node& n = nodes[i];
+		out += "{\"n\":" + std::to_string(i) + ",\"p\":";
+		out += n.parent == NO_PARENT ? std::string("-1") : std::to_string(n.parent);
+		out += ",\"lit\":";
+		writeText(out, n.lit);
+		if(n.summary) {
+			out += ",\"summary\":{\"open\":";
+			out += n.open ? "true" : "false";
+			out += ",\"nodes\":" + std::to_string(n.summary_nodes);
+			out += ",\"depth\":" + std::to_string(n.summary_depth) + "}}\n";
+			continue;
+		}
+		out += ",\"f\":";
+		writeIds(out, n.formulas);
+		if(!n.steps.empty()) {
+			out += ",\"steps\":[";
+			for(uint j=0; j < n.steps.size(); ++j) {
+				if(j) { out += ','; }
+				out += '[';
+				writeText(out, n.steps[j].first);
+				out += ',';
+				writeIds(out, n.steps[j].second);
+				out += ']';
+			}
+			out += ']';
+		}
+		out += "}\n";
+	}
+	return out;
+}